@@ -0,0 +1,115 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_ATOMIC_WRITER_HPP
+#define CONFIG_INI_ATOMIC_WRITER_HPP
+
+#include <stdint.h>
+#include <iosfwd>
+#include <string>
+
+namespace config {
+namespace ini {
+
+class editable_document;
+
+/**
+ * @brief Crash-safe writer of configuration files.
+ *
+ * The content is written to a temporary file in the directory of the
+ * target, flushed to disk and renamed over the target, after which the
+ * directory itself is flushed.  Readers observe either the old or the
+ * new file, never a truncated one.  A new file is created with mode 0666
+ * minus the umask, a replaced file keeps its mode.
+ */
+class atomic_writer {
+public:
+    /**
+     * @brief Time spent in each step of the last write, in nanoseconds.
+     */
+    struct timings {
+        uint64_t open_ns;
+        uint64_t write_ns;
+        uint64_t fsync_ns;
+        uint64_t rename_ns;
+        uint64_t dir_fsync_ns;
+        uint64_t total_ns;
+    };
+
+    /**
+     * @brief Constructs writer of the file \p path.
+     */
+    explicit atomic_writer(const std::string &path);
+
+    /**
+     * @brief Sets the size of chunks passed to write(2).  Large chunks
+     * reduce the number of system calls for big documents.
+     */
+    void set_buffer_size(std::size_t size);
+
+    /**
+     * @brief Enables or disables flushing of the parent directory after
+     * rename.  Enabled by default.
+     */
+    void set_sync_directory(bool sync);
+
+    /**
+     * @brief Atomically replaces the file with \p content.
+     * @return true on success, false otherwise (see error() and
+     *         replaced())
+     */
+    bool write(const std::string &content);
+
+    /**
+     * @brief Atomically replaces the file with the document \p doc
+     * including all pending modifications.
+     */
+    bool write(const editable_document &doc);
+
+    /**
+     * @brief Returns true if the last write renamed the new content over
+     * the file.  A write that fails afterwards, because the directory
+     * could not be flushed, has replaced the file but the rename may not
+     * survive a crash.
+     */
+    bool replaced() const { return replaced_; }
+
+    /**
+     * @brief Returns timings of the last write.
+     */
+    const timings &last_timings() const { return timings_; }
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    typedef void (*save_function)(std::ostream &, const void *);
+
+    bool write_content(save_function, const void *);
+    bool fail(const char *what, const std::string &path);
+
+    std::string path_;
+    std::string error_;
+    std::size_t buffer_size_;
+    bool sync_directory_;
+    bool replaced_;
+    timings timings_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_BULK_LOADER_HPP
+#define CONFIG_INI_BULK_LOADER_HPP
+
+#include "config/ini/parser.hpp"
+#include <string>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+class document;
+
+/**
+ * @brief Reads and parses many independent files at once.
+ *
+ * Up to queue_depth files are read concurrently, through io_uring where
+ * the kernel supports it or by a pool of reader threads otherwise.  Each
+ * file is read into memory in full and handed to one of the parser
+ * threads as soon as it arrives, so the time to load a large set of
+ * files is bound by the queue depth rather than by the latency of
+ * sequential reads.  Reading waits while queue_depth files wait for a
+ * parser thread, so memory use is bound by the queue depth rather than
+ * by the number of files.  Include directives are not followed, use
+ * loader for files that include others.
+ */
+class bulk_loader {
+public:
+    enum engine {
+        /// io_uring if available, reader threads otherwise.
+        ENGINE_AUTO,
+        ENGINE_IO_URING,
+        ENGINE_THREADS
+    };
+
+    /**
+     * @brief Receives the loaded files.  Methods are called from the
+     * parser threads, concurrently for different files.
+     */
+    class handler {
+    public:
+        virtual ~handler() {}
+
+        /**
+         * @brief Called with a parser of the file paths[\p index].
+         */
+        virtual void parse(std::size_t index, const std::string &path,
+                           parser &p) = 0;
+
+        /**
+         * @brief Called when the file paths[\p index] cannot be read.
+         */
+        virtual void fail(std::size_t index, const std::string &path,
+                          const std::string &error) = 0;
+    };
+
+    /**
+     * @brief Constructs loader parsing files in \p workers threads and
+     * reading at most \p queue_depth files at once.
+     */
+    explicit bulk_loader(std::size_t workers = 4,
+                         std::size_t queue_depth = 64);
+
+    /**
+     * @brief Selects the way files are read, ENGINE_AUTO by default.
+     */
+    void set_engine(engine e) { engine_ = e; }
+
+    /**
+     * @brief Returns the engine that read files in the last run.
+     */
+    engine used_engine() const { return used_; }
+
+    /**
+     * @brief Reads and parses files \p paths passing them to \p h.
+     * Failures of individual files are reported to the handler.
+     * @return true if every file was passed to the handler, false if
+     *         the engine failed (see error())
+     */
+    bool run(const std::vector<std::string> &paths, handler &h);
+
+    /**
+     * @brief Loads the file paths[i] into docs[i] for every i.  The
+     * error of the file, if any, is stored in errors[i].
+     * @return true if all files were loaded, false otherwise
+     */
+    bool load(const std::vector<std::string> &paths,
+              const std::vector<document *> &docs,
+              std::vector<std::string> &errors);
+
+    /**
+     * @brief Returns description of the failure of the engine.
+     */
+    const std::string &error() const { return error_; }
+
+    /**
+     * @brief Returns true if the kernel supports the io_uring operations
+     * the loader needs.
+     */
+    static bool io_uring_available();
+
+private:
+    // noncopyable
+    bulk_loader(const bulk_loader &);
+    bulk_loader &operator=(const bulk_loader &);
+
+    std::size_t workers_;
+    std::size_t queue_depth_;
+    engine engine_;
+    engine used_;
+    std::string error_;
+};
+}
+}
+
+#endif
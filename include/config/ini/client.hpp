@@ -0,0 +1,133 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_CLIENT_HPP
+#define CONFIG_INI_CLIENT_HPP
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Client of server with a read-through cache.
+ *
+ * Results of lookups are cached for the lifetime of the client, so
+ * repeated lookups never reach the server.  The cache is dropped when a
+ * response reports a generation different from the cached one, or
+ * explicitly with invalidate().
+ */
+class client {
+public:
+    struct query {
+        std::string section;
+        std::string name;
+        /// Filled by lookup().
+        bool found;
+        std::string value;
+
+        query() : found(false) {}
+        query(const std::string &s, const std::string &n)
+            : section(s)
+            , name(n)
+            , found(false)
+        {}
+    };
+
+    /**
+     * @brief Constructs client of the server listening on \p socket_path.
+     * The connection is established on first use.
+     */
+    explicit client(const std::string &socket_path);
+    ~client();
+
+    /**
+     * @brief Sets the maximum number of queries sent in one request.
+     * Larger batches are split into several pipelined requests.
+     */
+    void set_batch_size(std::size_t size);
+
+    /**
+     * @brief Resolves all \p queries, asking the server only for those
+     * missing in the cache.
+     * @return true on success, false otherwise (see error())
+     */
+    bool lookup(std::vector<query> &queries);
+
+    /**
+     * @brief Looks up a single parameter.
+     * @return true if the parameter exists, false if it does not or on
+     *         error (see error())
+     */
+    bool get(const std::string &section, const std::string &name,
+             std::string &value);
+
+    /**
+     * @brief Stores into \p names parameter names of the section
+     * \p section, empty if there is no such section.  Not cached.
+     * @return true on success, false otherwise (see error())
+     */
+    bool list(const std::string &section, std::vector<std::string> &names);
+
+    /**
+     * @brief Drops cached lookups.
+     */
+    void invalidate();
+
+    /**
+     * @brief Returns generation of the configuration seen in the last
+     * response or 0.
+     */
+    uint64_t generation() const { return generation_; }
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    typedef std::pair<std::string, std::string> key;
+    typedef std::pair<bool, std::string> entry;
+
+    // noncopyable
+    client(const client &);
+    client &operator=(const client &);
+
+    bool connect();
+    bool send(const std::string &frame, std::size_t &pos, bool may_stop);
+    bool receive(std::string &body);
+    bool receive_batch(std::vector<query> &queries,
+                       const std::vector<std::size_t> &missing,
+                       std::size_t batch, uint32_t first_id);
+    void check_generation(uint64_t generation);
+    void disconnect();
+    bool fail(const char *what);
+
+    std::string socket_path_;
+    std::string error_;
+    int fd_;
+    std::size_t batch_size_;
+    uint32_t next_id_;
+    uint64_t generation_;
+    std::map<key, entry> cache_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,306 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_DOCUMENT_HPP
+#define CONFIG_INI_DOCUMENT_HPP
+
+#include "config/ini/memory.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief In-memory representation of parsed configuration.
+ *
+ * Parameters are stored in order of first appearance.  Parameters
+ * preceding the first section belong to the section "".  Repeated
+ * sections and parameters are handled according to options: by default
+ * sections are merged and the last value of a parameter replaces earlier
+ * ones.
+ *
+ * A parameter may hold a list of values: "name[] = value" appends the
+ * value to the list "name", and with DUPLICATE_MERGE policy for
+ * parameters every repeated parameter is collected into a list.  Values of a
+ * parameter are kept contiguous in a single value array, so iterating a
+ * list is a linear walk.
+ *
+ * Sections and parameters are indexed by open addressing hash tables.
+ * Name hashes are computed once when a name is added and stored next to
+ * the original spelling.
+ *
+ * Section names are also treated as dot separated paths ("service.db"
+ * is nested in "service") and indexed by a trie of path components.
+ *
+ * All names, values and tables are allocated from the memory resource
+ * given to the constructor, which must outlive the document.  A document
+ * built in a monotonic_buffer_resource costs a handful of large
+ * allocations instead of one per string.
+ */
+class document {
+public:
+    enum duplicate_policy {
+        /// Repetition is an error.
+        DUPLICATE_ERROR,
+        /// The first occurrence wins, later ones are ignored.
+        DUPLICATE_FIRST,
+        /// The last occurrence replaces earlier ones.
+        DUPLICATE_LAST,
+        /// Sections are merged, values of parameters are collected into
+        /// lists.
+        DUPLICATE_MERGE
+    };
+
+    struct options {
+        /// Compare section and parameter names ignoring ASCII case.
+        bool case_insensitive;
+        duplicate_policy duplicate_sections;
+        duplicate_policy duplicate_params;
+
+        options()
+            : case_insensitive(false)
+            , duplicate_sections(DUPLICATE_MERGE)
+            , duplicate_params(DUPLICATE_LAST)
+        {}
+    };
+
+    /**
+     * @brief Parameter entry, allocator-aware so that its name stays in
+     * the resource of the vector holding it.
+     */
+    struct param {
+        typedef polymorphic_allocator<char> allocator_type;
+
+        param(std::size_t s, const char *n, std::size_t size,
+              std::size_t f, std::size_t c,
+              const allocator_type &a = allocator_type())
+            : section(s)
+            , name(n, size, a)
+            , first(f)
+            , count(c)
+        {}
+
+        param(const param &other, const allocator_type &a)
+            : section(other.section)
+            , name(other.name.data(), other.name.size(), a)
+            , first(other.first)
+            , count(other.count)
+        {}
+
+#if __cplusplus >= 201103L
+        param(param &&other, const allocator_type &a)
+            : section(other.section)
+            , name(std::move(other.name), a)
+            , first(other.first)
+            , count(other.count)
+        {}
+#endif
+
+        std::size_t section;
+        string name;
+        /// Range of the parameter values in the value array.
+        std::size_t first;
+        std::size_t count;
+    };
+
+    /**
+     * @brief Contiguous range of values.  Invalidated by modifications of
+     * the document.
+     */
+    struct value_range {
+        const string *first;
+        std::size_t count;
+
+        const string *begin() const { return first; }
+        const string *end() const { return first + count; }
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+    };
+
+    typedef std::vector<string, polymorphic_allocator<string> >
+        string_vector;
+    typedef std::vector<param, polymorphic_allocator<param> > param_vector;
+
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    explicit document(const options &opts = options(),
+                      memory_resource *resource = new_delete_resource());
+
+    /**
+     * @brief Starts a new section, subsequent parameters belong to it.
+     * @return false if the section violates the duplicate policy (see
+     *         error())
+     */
+    bool add_section(const std::string &name);
+
+    /**
+     * @brief Adds parameter to the current section.
+     * @return false if the parameter violates the duplicate policy (see
+     *         error())
+     */
+    bool add_param(const std::string &name, const std::string &value);
+
+    /**
+     * @brief Returns value of the parameter \p name in the section
+     * \p section or null pointer if there is no such parameter.  For lists
+     * the last value is returned.
+     */
+    const string *get(const std::string &section,
+                      const std::string &name) const;
+
+    /**
+     * @brief Returns all values of the parameter \p name in the section
+     * \p section, the range is empty if there is no such parameter.
+     */
+    value_range get_all(const std::string &section,
+                        const std::string &name) const;
+
+    /**
+     * @brief Returns values of the parameter \p p.
+     */
+    value_range values(const param &p) const;
+
+    /**
+     * @brief Returns index of the section \p name in sections() or npos
+     * if there is no such section.
+     */
+    std::size_t find_section(const std::string &name) const;
+
+    /**
+     * @brief Appends to \p out indices of the section \p path and of all
+     * sections nested in it, ordered by path components.  Sections that
+     * are not nested in any other section are under the path "".
+     * @return number of appended indices
+     */
+    std::size_t subtree(const std::string &path,
+                        std::vector<std::size_t> &out) const;
+
+    /**
+     * @brief Returns names of sections in order of appearance.  If names
+     * are case insensitive, the first spelling is kept.
+     */
+    const string_vector &sections() const { return sections_; }
+
+    /**
+     * @brief Returns parameters in order of first appearance.
+     */
+    const param_vector &params() const { return params_; }
+
+    const options &get_options() const { return options_; }
+
+    memory_resource *get_resource() const {
+        return sections_.get_allocator().resource();
+    }
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+    void clear();
+
+    /**
+     * @brief Exchanges contents with \p other in constant time.  Both
+     * documents must use the same memory resource.
+     */
+    void swap(document &other);
+
+private:
+    typedef std::vector<std::size_t, polymorphic_allocator<std::size_t> >
+        index_vector;
+    typedef std::vector<uint64_t, polymorphic_allocator<uint64_t> >
+        hash_vector;
+
+    uint64_t hash(const char *, std::size_t) const;
+    bool equal(const string &, const char *, std::size_t) const;
+    std::size_t section_slot(const std::string &, uint64_t) const;
+    std::size_t param_slot(std::size_t section, const char *, std::size_t,
+                           uint64_t) const;
+    std::size_t find_param(const std::string &section,
+                           const std::string &name) const;
+    void append_value(std::size_t param, const std::string &value);
+    void drop_params(std::size_t section);
+    void rehash_sections();
+    void rehash_params(std::size_t size);
+    void add_path(const string &, std::size_t section);
+    std::size_t find_child(std::size_t node, const char *name,
+                           std::size_t size, bool &found) const;
+
+    struct tree_node {
+        typedef polymorphic_allocator<std::size_t> allocator_type;
+
+        tree_node(std::size_t n, std::size_t o, std::size_t sz,
+                  const allocator_type &a)
+            : section_name(n)
+            , offset(o)
+            , size(sz)
+            , section(npos)
+            , children(a)
+        {}
+
+        tree_node(const tree_node &other, const allocator_type &a)
+            : section_name(other.section_name)
+            , offset(other.offset)
+            , size(other.size)
+            , section(other.section)
+            , children(other.children.begin(), other.children.end(), a)
+        {}
+
+#if __cplusplus >= 201103L
+        tree_node(tree_node &&other, const allocator_type &a)
+            : section_name(other.section_name)
+            , offset(other.offset)
+            , size(other.size)
+            , section(other.section)
+            , children(std::move(other.children), a)
+        {}
+#endif
+
+        /// Path component, a range of the name of the section that
+        /// introduced the node.
+        std::size_t section_name;
+        std::size_t offset;
+        std::size_t size;
+        /// Section with this path or npos.
+        std::size_t section;
+        /// Children ordered by component.
+        index_vector children;
+    };
+
+    options options_;
+    string_vector sections_;
+    hash_vector section_hashes_;
+    param_vector params_;
+    /// Hashes of parameter keys, parallel to params_.
+    hash_vector param_hashes_;
+    /// Number of value slots reserved for each parameter.
+    index_vector capacities_;
+    string_vector values_;
+    /// Tables of indices plus one, zero marks a free slot.
+    index_vector section_slots_;
+    index_vector param_slots_;
+    /// Trie of dotted section paths, the root is the empty path.
+    std::vector<tree_node, polymorphic_allocator<tree_node> > tree_;
+    std::size_t current_;
+    /// Parameters of the current section are ignored.
+    bool skip_params_;
+    std::string error_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_EDITABLE_DOCUMENT_HPP
+#define CONFIG_INI_EDITABLE_DOCUMENT_HPP
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Lossless .ini document that can be modified and written back
+ * without disturbing comments and layout.
+ *
+ * The original bytes are kept intact and described by a sequence of
+ * segments that covers the whole input.  Modifications are recorded as
+ * byte range replacements, so saving a document copies every untouched
+ * range verbatim and writes only the changed spans.
+ */
+class editable_document {
+public:
+    struct segment {
+        enum kind {
+            LAYOUT,  ///< whitespace, line breaks and punctuation
+            COMMENT, ///< comment including the leading ';'
+            SECTION, ///< section name without brackets
+            NAME,    ///< parameter name
+            VALUE    ///< parameter value
+        };
+
+        kind type;
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    editable_document();
+
+    /**
+     * @brief Reads the whole input stream \p in and indexes it.
+     * @return true on success, false on a parse error (see error())
+     */
+    bool load(std::istream &in, const std::string &filename = "(Unknown)");
+
+    /**
+     * @brief Returns current value of the parameter \p name in the
+     * section \p section or null pointer if there is no such parameter.
+     * Parameters preceding the first section belong to the section "".
+     */
+    const std::string *get(const std::string &section,
+                           const std::string &name) const;
+
+    /**
+     * @brief Sets the parameter \p name in the section \p section to
+     * \p value.  Missing parameters are appended to the end of the
+     * section, missing sections are appended to the end of the document.
+     */
+    void set(const std::string &section, const std::string &name,
+             const std::string &value);
+
+    /**
+     * @brief Writes the document with all modifications applied to
+     * \p os.
+     */
+    void save(std::ostream &os) const;
+
+    /**
+     * @brief Returns the document with all modifications applied.
+     */
+    std::string str() const;
+
+    /**
+     * @brief Returns the original text of the document.
+     */
+    const std::string &text() const { return text_; }
+
+    /**
+     * @brief Returns segments covering the original text.
+     */
+    const std::vector<segment> &segments() const { return segments_; }
+
+    /**
+     * @brief Returns description of the last load error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    typedef std::pair<std::string, std::string> key;
+
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    struct param {
+        /// Index of the value segment, npos for added parameters.
+        std::size_t value_segment;
+        std::string value;
+        /// Source form of the modified value.
+        std::string text;
+    };
+
+    void add_layout(std::size_t from, std::size_t to);
+    void add_segment(segment::kind, std::size_t offset, std::size_t length);
+    std::size_t line_end(std::size_t offset) const;
+
+    std::string text_;
+    std::string error_;
+    std::vector<segment> segments_;
+    std::map<key, param> params_;
+    /// Offset where new parameters of a section are inserted.
+    std::map<std::string, std::size_t> section_ends_;
+    /// Parameters missing in the original text, in order of addition.
+    std::vector<key> added_;
+    /// Modified values keyed by offset in the original text.
+    std::map<std::size_t, const param *> edits_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,217 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_FIXED_PARSER_HPP
+#define CONFIG_INI_FIXED_PARSER_HPP
+
+#include "config/ini/parser.hpp"
+#include <cstddef>
+#include <cstring>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Stores tokens as views of the input, see string_tokens for the
+ * operations.
+ *
+ * A token starts as a view of the input and is extended as long as the
+ * consumed bytes follow each other.  The first byte that does not (an
+ * unescaped character, a byte after a folded line break) moves the token
+ * to the scratch buffer, where it is built from then on.  Error messages
+ * are formatted into a fixed buffer and truncated if too long.
+ */
+class view_tokens {
+public:
+    /**
+     * @brief Parser event, its data is valid until the next call of
+     * advance().
+     */
+    struct event {
+        parser_base::event_type type;
+        const char *data;
+        std::size_t size;
+        /// Byte offset of the token in the input.
+        std::size_t offset;
+        /// Number of source bytes the token occupies.
+        std::size_t length;
+    };
+
+    /// Capacity of the error message buffer.
+    static const std::size_t max_diagnostic = 192;
+
+    view_tokens(char *scratch, std::size_t scratch_size, const char *filename)
+        : scratch_(scratch)
+        , scratch_size_(scratch_size)
+        , filename_(filename)
+    {
+        reset();
+        diagnostic_[0] = '\0';
+    }
+
+    void clear(event &e, const char *at) {
+        e.data = at;
+        e.size = 0;
+        owned_ = false;
+        overflow_ = false;
+    }
+    std::size_t size(const event &e) const { return e.size; }
+    const char *data(const event &e) const { return e.data; }
+
+    void take(event &e, char c, const char *p) {
+        if (!owned_) {
+            if (e.size == 0)
+                e.data = p;
+            if (e.data + e.size == p) {
+                ++e.size;
+                return;
+            }
+        }
+        put(e, c);
+    }
+
+    void append(event &e, const char *first, const char *last) {
+        if (!owned_) {
+            if (e.size == 0)
+                e.data = first;
+            if (e.data + e.size == first) {
+                e.size += last - first;
+                return;
+            }
+        }
+        for (; first != last; ++first)
+            put(e, *first);
+    }
+
+    /// Moves the token to the scratch buffer and appends \p c.
+    void put(event &e, char c) {
+        if (!owned_) {
+            owned_ = true;
+            if (e.size > scratch_size_) {
+                overflow_ = true;
+                e.size = 0;
+            } else {
+                std::memcpy(scratch_, e.data, e.size);
+            }
+            e.data = scratch_;
+        }
+        if (e.size == scratch_size_) {
+            overflow_ = true;
+            return;
+        }
+        scratch_[e.size++] = c;
+    }
+
+    void truncate(event &e, std::size_t n) { e.size = n; }
+
+    void hold(event &e, std::size_t n) {
+        held_data_ = e.data + n;
+        held_size_ = e.size - n;
+        held_owned_ = owned_;
+        e.size = n;
+    }
+
+    void resume(event &e) {
+        // Held bytes of a copied token follow the emitted part in the
+        // scratch buffer.
+        if (held_owned_) {
+            std::memmove(scratch_, held_data_, held_size_);
+            e.data = scratch_;
+        } else {
+            e.data = held_data_;
+        }
+        e.size = held_size_;
+        owned_ = held_owned_;
+        held_size_ = 0;
+    }
+
+    /// The token did not fit into the scratch buffer.
+    bool overflow() const { return overflow_; }
+
+    void reset() {
+        owned_ = false;
+        overflow_ = false;
+        held_data_ = 0;
+        held_size_ = 0;
+        held_owned_ = false;
+    }
+
+    void error(event &e, std::size_t line, std::size_t column,
+               const char *message);
+
+#if __cplusplus >= 201103L
+    void swap(view_tokens &other);
+#endif
+
+private:
+    char *scratch_;
+    std::size_t scratch_size_;
+    const char *filename_;
+    /// The token is copied to the scratch buffer.
+    bool owned_;
+    bool overflow_;
+    /// Bytes of the value read but not emitted yet.
+    const char *held_data_;
+    std::size_t held_size_;
+    bool held_owned_;
+    char diagnostic_[max_diagnostic];
+};
+
+/**
+ * @brief Pull parser of an in-memory file that never allocates.
+ *
+ * The parser is the state machine of basic_parser over the input block,
+ * so it accepts the same grammar, produces the same events and supports
+ * the same settings, including UTF-8 validation, limits and value
+ * chunks.  Tokens are views: a token that is a contiguous part of the
+ * input points into it; a token that has to be rewritten (escape
+ * sequences, folded line continuations) is copied into the scratch
+ * buffer supplied by the caller.  A token that does not fit into the
+ * scratch buffer is reported as an error.
+ *
+ * Nothing throws and no memory is allocated, so the parser may be used
+ * where the heap is not available yet or must not be touched.
+ */
+template <typename Dialect>
+class basic_fixed_parser : public parser_machine<Dialect, view_tokens> {
+public:
+    typedef view_tokens::event event;
+
+    /// Capacity of the error message buffer.
+    static const std::size_t max_diagnostic = view_tokens::max_diagnostic;
+
+    /**
+     * @brief Constructs parser of the input [\p data, \p data + \p size)
+     * named \p filename, copying rewritten tokens into the buffer
+     * [\p scratch, \p scratch + \p scratch_size).  The input, the
+     * scratch buffer and the name must outlive the parser.
+     */
+    basic_fixed_parser(const char *data, std::size_t size, char *scratch,
+                       std::size_t scratch_size,
+                       const char *filename = "(Unknown)");
+
+private:
+    // noncopyable, events may point into the parser
+    basic_fixed_parser(const basic_fixed_parser &);
+    basic_fixed_parser &operator=(const basic_fixed_parser &);
+
+    typedef parser_machine<Dialect, view_tokens> machine;
+};
+
+typedef basic_fixed_parser<default_dialect> fixed_parser;
+}
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_INTERPOLATOR_HPP
+#define CONFIG_INI_INTERPOLATOR_HPP
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+class document;
+
+/**
+ * @brief Expands references inside values of a document.
+ *
+ * "${section:name}" is replaced with the expanded value of the parameter
+ * \p name in the section \p section, "${NAME}" is replaced with the value
+ * of the environment variable NAME (empty if it is not set), "$$" is
+ * replaced with "$".
+ *
+ * References form a dependency graph which is resolved once: every value
+ * is expanded exactly once after all values it refers to.  On reload only
+ * values that changed, values that refer to changed environment variables
+ * and everything that depends on them are expanded again.
+ */
+class interpolator {
+public:
+    interpolator();
+
+    /**
+     * @brief Expands all values of the document \p doc.
+     * @return true on success, false on unresolved reference or cycle
+     *         (see error())
+     */
+    bool resolve(const document &doc);
+
+    /**
+     * @brief Expands values of the new version of the document \p doc
+     * reusing results of the previous resolve() or reload() for values
+     * not affected by changes.
+     */
+    bool reload(const document &doc);
+
+    /**
+     * @brief Returns expanded value of the parameter \p name in the
+     * section \p section or null pointer if there is no such parameter.
+     */
+    const std::string *get(const std::string &section,
+                           const std::string &name) const;
+
+    /**
+     * @brief Returns number of values expanded by the last resolve() or
+     * reload().
+     */
+    std::size_t expansions() const { return expansions_; }
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    typedef std::pair<std::string, std::string> key;
+
+    enum node_state {
+        UNRESOLVED,
+        VISITING,
+        RESOLVED
+    };
+
+    struct piece {
+        enum kind {
+            TEXT,
+            REF,
+            ENV
+        };
+
+        kind type;
+        /// Literal text, environment variable or "section:name".
+        std::string text;
+        /// Referenced node for REF pieces, npos if there is none.
+        std::size_t node;
+    };
+
+    struct node {
+        const key *name;
+        std::string raw;
+        std::string value;
+        std::vector<piece> pieces;
+        std::vector<std::size_t> dependents;
+        node_state state;
+    };
+
+    void split(const std::string &raw, std::vector<piece> &pieces) const;
+    bool expand(std::size_t root);
+    bool fail(const std::string &message);
+
+    std::vector<node> nodes_;
+    std::map<key, std::size_t> index_;
+    /// Values of environment variables used by the last expansion.
+    std::map<std::string, std::string> env_;
+    std::size_t expansions_;
+    std::string error_;
+};
+}
+}
+
+#endif
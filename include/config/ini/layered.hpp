@@ -0,0 +1,118 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_LAYERED_HPP
+#define CONFIG_INI_LAYERED_HPP
+
+#include "config/ini/document.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Read-only view of a stack of documents where upper layers
+ * override lower ones.
+ *
+ * Layers are referenced, not copied, and must outlive the view.  Without
+ * an index a lookup walks the layers from the top.  flatten() builds a
+ * merged index of all keys, after which a lookup is a single hash probe;
+ * the index must be rebuilt whenever a layer changes.  A parameter of an
+ * upper layer replaces all values of the same parameter below it, lists
+ * are not merged across layers.
+ *
+ * Names are compared as configured by the options of the bottom layer,
+ * all layers are expected to share them.
+ */
+class layered {
+public:
+    layered();
+
+    /**
+     * @brief Adds \p layer on top of the existing layers.  Drops the
+     * index.
+     */
+    void push(const document &layer);
+
+    /**
+     * @brief Builds the merged index of all layers.
+     */
+    void flatten();
+
+    bool flattened() const { return !slots_.empty(); }
+
+    /**
+     * @brief Returns value of the parameter \p name in the section
+     * \p section from the topmost layer that defines it or null pointer
+     * if no layer does.
+     */
+    const string *get(const std::string &section,
+                      const std::string &name) const;
+
+    /**
+     * @brief Returns all values of the parameter from the topmost layer
+     * that defines it.
+     */
+    document::value_range get_all(const std::string &section,
+                                  const std::string &name) const;
+
+    const std::vector<const document *> &layers() const { return layers_; }
+
+    void clear();
+
+private:
+    struct entry {
+        uint32_t hash;
+        uint32_t layer;
+        std::size_t param;
+    };
+
+    /// Looks the key up in the merged index.
+    const document::param *find(const std::string &section,
+                                const std::string &name,
+                                const document *&layer) const;
+
+    std::vector<const document *> layers_;
+    std::vector<entry> entries_;
+    /// Indices of entries plus one, zero marks a free slot.
+    std::vector<std::size_t> slots_;
+};
+
+/**
+ * @brief Adds to \p out every environment variable starting with
+ * \p prefix.  The rest of the variable name is split at the first "__"
+ * into a section and a parameter name, both lowercased; a name without
+ * "__" belongs to the section "".  For example, with the prefix "APP_"
+ * the variable APP_DB__HOST sets "host" in the section "db".
+ * @return false if \p out rejects a parameter (see document::error())
+ */
+bool load_environment(const std::string &prefix, document &out);
+
+/**
+ * @brief Adds to \p out parameters given as "--section.name=value"
+ * arguments.  The section is the part before the last dot, so
+ * "--service.db.host=x" sets "host" in the section "service.db", and
+ * "--name=value" sets "name" in the section "".  Other arguments are
+ * appended to \p rest if it is not null.
+ * @return false if \p out rejects a parameter (see document::error())
+ */
+bool load_arguments(int argc, const char *const *argv, document &out,
+                    std::vector<std::string> *rest = 0);
+}
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_LAZY_DOCUMENT_HPP
+#define CONFIG_INI_LAZY_DOCUMENT_HPP
+
+#include "config/ini/document.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Document that parses sections on first access.
+ *
+ * open() maps the file and only scans it for section headers, recording
+ * the byte range of every section.  A section is parsed when it is
+ * accessed for the first time, so the cost of opening grows with the
+ * number of lines rather than with the amount of parsing, and the cost
+ * of lookups with the size of the sections actually used.  Parsed
+ * sections are kept in a document built with the given options.
+ *
+ * Syntax errors are reported when the offending section is accessed.
+ * "!include" directives are not supported.
+ */
+class lazy_document {
+public:
+    explicit lazy_document(
+        const document::options &opts = document::options());
+    ~lazy_document();
+
+    /**
+     * @brief Maps the file \p path and indexes its sections.
+     * @return true on success, false otherwise (see error())
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief Parses all occurrences of the section \p section unless they
+     * are parsed already.  A missing section is not an error.  A section
+     * that failed to parse is not parsed again, every later access
+     * reports the same error.
+     * @return false on syntax errors (see error())
+     */
+    bool load_section(const std::string &section);
+
+    /**
+     * @brief Returns value of the parameter \p name in the section
+     * \p section, parsing the section if needed, or null pointer if there
+     * is no such parameter or the section is malformed (see error()).
+     */
+    const string *get(const std::string &section,
+                      const std::string &name);
+
+    /**
+     * @brief Returns all values of the parameter, parsing the section if
+     * needed.
+     */
+    document::value_range get_all(const std::string &section,
+                                  const std::string &name);
+
+    /**
+     * @brief Returns number of distinct sections in the file.
+     */
+    std::size_t section_count() const { return index_.size(); }
+
+    /**
+     * @brief Returns number of sections parsed successfully so far.
+     */
+    std::size_t loaded_sections() const { return loaded_; }
+
+    /**
+     * @brief Returns the parsed part of the configuration.
+     */
+    const document &get_document() const { return doc_; }
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    /// Byte range of one occurrence of a section header and its body.
+    struct range {
+        std::size_t offset;
+        std::size_t length;
+        std::size_t line;
+    };
+
+    struct section_entry {
+        std::vector<range> ranges;
+        /// Parsing was attempted.
+        bool loaded;
+        /// Error of the failed attempt.
+        std::string error;
+    };
+
+    // noncopyable
+    lazy_document(const lazy_document &);
+    lazy_document &operator=(const lazy_document &);
+
+    void close();
+    void scan();
+    std::string key(const std::string &section) const;
+    bool parse(const std::string &section, const range &r);
+
+    document doc_;
+    std::string path_;
+    std::string error_;
+    const char *data_;
+    std::size_t size_;
+    std::size_t loaded_;
+    /// Sections by name, folded if names are case insensitive.
+    std::map<std::string, section_entry> index_;
+};
+}
+}
+
+#endif
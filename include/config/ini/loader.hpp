@@ -0,0 +1,124 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_LOADER_HPP
+#define CONFIG_INI_LOADER_HPP
+
+#include "config/ini/parser.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+class document;
+
+/**
+ * @brief Loads configuration files into documents resolving
+ * "!include path" directives.
+ *
+ * An included file is inserted in place of the directive, relative paths
+ * are resolved against the directory of the including file.  Every file
+ * is parsed at most once per loader: parser events are cached by
+ * canonical path and replayed on subsequent includes, so a base file
+ * shared by many configurations is read only once.
+ */
+class loader {
+public:
+    loader();
+
+    /**
+     * @brief Loads file \p path and all files it includes into \p doc.
+     * @return true on success, false otherwise (see error())
+     */
+    bool load(const std::string &path, document &doc);
+
+    /**
+     * @brief Returns description of the last error including the chain
+     * of files that led to the failing one.
+     */
+    const std::string &error() const { return error_; }
+
+    /**
+     * @brief Returns number of distinct files parsed so far.
+     */
+    std::size_t parsed_files() const { return cache_.size(); }
+
+    /**
+     * @brief Appends to \p out canonical paths of the files parsed so far.
+     */
+    void files(std::vector<std::string> &out) const;
+
+    /**
+     * @brief Sets bounds on the loaded files.  Limits of a single file
+     * apply to every parsed file, max_entries also bounds the number of
+     * entries added by a load across all files and max_include_depth the
+     * nesting of included files.  Drops cached files.
+     */
+    void set_limits(const parser::limits &l);
+
+    /**
+     * @brief Returns the bound that stopped the last load or LIMIT_NONE.
+     */
+    parser::limits::kind exceeded_limit() const { return exceeded_; }
+
+    /**
+     * @brief Makes the loader read files ahead in a background thread
+     * (see readahead_buf), which pays off for large files on slow storage.
+     */
+    void set_readahead(bool enabled) { readahead_ = enabled; }
+
+    /**
+     * @brief Drops cached files, so they are parsed again on next load.
+     */
+    void clear_cache();
+
+private:
+    typedef std::vector<parser::event> events;
+
+    struct parsed_file {
+        events evs;
+        /// The bound that stopped parsing of the file.
+        parser::limits::kind exceeded;
+    };
+
+    // noncopyable
+    loader(const loader &);
+    loader &operator=(const loader &);
+
+    const parsed_file &parse(const std::string &path);
+    bool replay(const std::string &path, document &doc);
+    bool include(const std::string &path, document &doc);
+    bool fail(const std::string &message);
+    bool fail_at(const std::string &path, const std::string &message);
+    bool count_entry(const std::string &path);
+
+    /// Reused for every file, so its buffer is allocated once.
+    parser parser_;
+    std::map<std::string, parsed_file> cache_;
+    parser::limits limits_;
+    parser::limits::kind exceeded_;
+    /// Number of entries added by the current load.
+    std::size_t entries_;
+    bool readahead_;
+    /// Canonical paths of files being loaded, outermost first.
+    std::vector<std::string> stack_;
+    std::string error_;
+};
+}
+}
+
+#endif
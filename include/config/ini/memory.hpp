@@ -0,0 +1,274 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_MEMORY_HPP
+#define CONFIG_INI_MEMORY_HPP
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+
+#if __cplusplus >= 201103L
+#include <memory>
+#include <type_traits>
+#endif
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define CONFIG_INI_HAS_STD_PMR 1
+#endif
+#endif
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Source of memory for documents, modelled after
+ * std::pmr::memory_resource so that the library does not require C++17.
+ */
+class memory_resource {
+public:
+    virtual ~memory_resource() {}
+
+    void *allocate(std::size_t bytes,
+                   std::size_t alignment = sizeof(void *)) {
+        return do_allocate(bytes, alignment);
+    }
+
+    void deallocate(void *p, std::size_t bytes,
+                    std::size_t alignment = sizeof(void *)) {
+        do_deallocate(p, bytes, alignment);
+    }
+
+    /**
+     * @brief Returns true if memory allocated by \p other may be
+     * deallocated by this resource and vice versa.
+     */
+    bool is_equal(const memory_resource &other) const {
+        return this == &other || do_is_equal(other);
+    }
+
+private:
+    virtual void *do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+    virtual void do_deallocate(void *p, std::size_t bytes,
+                               std::size_t alignment) = 0;
+    virtual bool do_is_equal(const memory_resource &other) const = 0;
+};
+
+/**
+ * @brief Returns the resource using global operator new and delete.
+ */
+memory_resource *new_delete_resource();
+
+/**
+ * @brief Resource that carves allocations out of large blocks and frees
+ * them all at once.
+ *
+ * Deallocation is a no-op, memory is returned to the upstream resource
+ * by release() or the destructor.  The first block is the buffer given
+ * to the constructor, if any; every next block is twice as large as the
+ * previous one.  The resource is not thread-safe.
+ */
+class monotonic_buffer_resource : public memory_resource {
+public:
+    explicit monotonic_buffer_resource(
+        memory_resource *upstream = new_delete_resource());
+
+    /**
+     * @brief Constructs resource that first allocates from the buffer
+     * [\p buffer, \p buffer + \p size).
+     */
+    monotonic_buffer_resource(void *buffer, std::size_t size,
+                              memory_resource *upstream =
+                                  new_delete_resource());
+
+    ~monotonic_buffer_resource();
+
+    /**
+     * @brief Returns all blocks to the upstream resource.  Memory
+     * allocated so far must not be used afterwards.
+     */
+    void release();
+
+    memory_resource *upstream_resource() const { return upstream_; }
+
+private:
+    struct block {
+        block *next;
+        std::size_t size;
+    };
+
+    // noncopyable
+    monotonic_buffer_resource(const monotonic_buffer_resource &);
+    monotonic_buffer_resource &operator=(const monotonic_buffer_resource &);
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment);
+    void do_deallocate(void *, std::size_t, std::size_t) {}
+    bool do_is_equal(const memory_resource &other) const {
+        return this == &other;
+    }
+
+    memory_resource *upstream_;
+    char *initial_;
+    std::size_t initial_size_;
+    /// Free part of the current block.
+    char *cur_;
+    char *end_;
+    std::size_t next_size_;
+    /// Blocks allocated from upstream, the newest first.
+    block *blocks_;
+};
+
+#ifdef CONFIG_INI_HAS_STD_PMR
+/**
+ * @brief Adapts a std::pmr::memory_resource, such as a pool of huge
+ * pages, for use by the library.
+ */
+class std_memory_resource : public memory_resource {
+public:
+    explicit std_memory_resource(std::pmr::memory_resource *r)
+        : r_(r)
+    {}
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) {
+        return r_->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) {
+        r_->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const memory_resource &other) const {
+        const std_memory_resource *o =
+            dynamic_cast<const std_memory_resource *>(&other);
+        return o && r_->is_equal(*o->r_);
+    }
+
+    std::pmr::memory_resource *r_;
+};
+#endif
+
+/**
+ * @brief Allocator drawing memory from a memory_resource, the
+ * counterpart of std::pmr::polymorphic_allocator.
+ *
+ * As with std::pmr the resource is not propagated: a copy of a container
+ * uses new_delete_resource(), so it does not depend on the lifetime of
+ * the original's resource, and allocator-aware elements (those with an
+ * allocator_type taking the allocator as the last constructor argument)
+ * are constructed with the resource of their container.  Standard
+ * libraries before C++11 ignore these rules and copies keep the resource
+ * of the original.
+ */
+template <typename T> class polymorphic_allocator {
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U> struct rebind {
+        typedef polymorphic_allocator<U> other;
+    };
+
+    polymorphic_allocator()
+        : r_(new_delete_resource())
+    {}
+
+    polymorphic_allocator(memory_resource *r)
+        : r_(r)
+    {}
+
+    template <typename U>
+    polymorphic_allocator(const polymorphic_allocator<U> &other)
+        : r_(other.resource())
+    {}
+
+    T *allocate(std::size_t n, const void * = 0) {
+        return static_cast<T *>(r_->allocate(n * sizeof(T), alignment()));
+    }
+
+    void deallocate(T *p, std::size_t n) {
+        r_->deallocate(p, n * sizeof(T), alignment());
+    }
+
+#if __cplusplus >= 201103L
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&...args) {
+        construct_using(std::uses_allocator<U, polymorphic_allocator>(), p,
+                        std::forward<Args>(args)...);
+    }
+#else
+    void construct(T *p, const T &v) { new (p) T(v); }
+#endif
+    void destroy(T *p) { p->~T(); }
+
+    std::size_t max_size() const { return std::size_t(-1) / sizeof(T); }
+
+    T *address(T &v) const { return &v; }
+    const T *address(const T &v) const { return &v; }
+
+    memory_resource *resource() const { return r_; }
+
+    polymorphic_allocator select_on_container_copy_construction() const {
+        return polymorphic_allocator();
+    }
+
+private:
+#if __cplusplus >= 201103L
+    template <typename U, typename... Args>
+    void construct_using(std::true_type, U *p, Args &&...args) {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)..., *this);
+    }
+
+    template <typename U, typename... Args>
+    void construct_using(std::false_type, U *p, Args &&...args) {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+#endif
+
+    struct probe {
+        char c;
+        T v;
+    };
+
+    static std::size_t alignment() { return sizeof(probe) - sizeof(T); }
+
+    memory_resource *r_;
+};
+
+template <typename T, typename U>
+bool operator==(const polymorphic_allocator<T> &lhs,
+                const polymorphic_allocator<U> &rhs) {
+    return lhs.resource()->is_equal(*rhs.resource());
+}
+
+template <typename T, typename U>
+bool operator!=(const polymorphic_allocator<T> &lhs,
+                const polymorphic_allocator<U> &rhs) {
+    return !(lhs == rhs);
+}
+
+/// String allocated from a memory_resource.
+typedef std::basic_string<char, std::char_traits<char>,
+                          polymorphic_allocator<char> > string;
+}
+}
+
+#endif
@@ -16,21 +16,61 @@
 #ifndef CONFIG_INI_PARSER_HPP
 #define CONFIG_INI_PARSER_HPP
 
+#include <stdint.h>
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 namespace config {
 namespace ini {
 
 /**
- * @brief Pull .ini file parser implementation.
+ * @brief Grammar of the default dialect: ';' comments, '=' delimiters
+ * and keys starting with a letter or a digit.
+ *
+ * A dialect is a class with static predicates classifying characters.
+ * The parser calls them in its scanning loops, so each dialect gets its
+ * own specialized code and pays nothing for flexibility at run time.
+ */
+struct default_dialect {
+    /// Starts a comment that runs to the end of the line.
+    static bool is_comment(char c) { return c == ';'; }
+    /// Separates a key from its value.
+    static bool is_delimiter(char c) { return c == '='; }
+    /// May start a key.
+    static bool is_key_start(char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+               (c >= 'A' && c <= 'Z');
+    }
+};
+
+/**
+ * @brief Dialect of Unix style files: ';' and '#' comments, '=' and ':'
+ * delimiters, keys may also start with '_', '-' or '.'.
+ */
+struct relaxed_dialect {
+    static bool is_comment(char c) { return c == ';' || c == '#'; }
+    static bool is_delimiter(char c) { return c == '=' || c == ':'; }
+    static bool is_key_start(char c) {
+        return default_dialect::is_key_start(c) || c == '_' || c == '-' ||
+               c == '.';
+    }
+};
+
+/**
+ * @brief Types shared by parsers of all dialects.
  */
-class parser {
+class parser_base {
 public:
     enum event_type {
         EVENT_SECTION,
         EVENT_NAME,
         EVENT_VALUE,
+        /// Leading part of a value longer than the chunk size, the rest
+        /// follows in further parts and a final EVENT_VALUE.
+        EVENT_VALUE_PART,
+        /// "!include path" directive, the value is the path
+        EVENT_INCLUDE,
         EVENT_ERROR,
         EVENT_END
     };
@@ -38,60 +78,408 @@ public:
     struct event {
         event_type type;
         std::string value;
+        /// Byte offset of the token in the input stream.
+        std::size_t offset;
+        /// Number of source bytes the token occupies.
+        std::size_t length;
     };
 
     /**
-     * @brief Constructs parser of input stream \p in.
+     * @brief Parser hot path counters.
+     *
+     * The counters are collected only if the library is built with
+     * CONFIG_INI_PARSER_STATS defined, otherwise they stay zero and the
+     * parser does not pay for them.  Only the library needs the macro.
      */
-    parser(std::istream &in);
+    struct stats {
+        enum state_kind {
+            STATE_GEN,
+            STATE_SECTION,
+            STATE_PARAM,
+            STATE_VALUE,
+            STATE_COUNT
+        };
+
+        /// Whether the counters are collected by this build.
+        static const bool enabled;
+
+        std::size_t bytes;
+        std::size_t events[EVENT_END + 1];
+        std::size_t comment_bytes;
+        std::size_t whitespace_bytes;
+        std::size_t put_backs;
+        std::size_t errors;
+        /// Time spent in each state function excluding nested calls.
+        uint64_t state_ns[STATE_COUNT];
+    };
 
     /**
-     * @brief Constructs parser of input stream \p in assuming that
-     * filename is \p filename.
+     * @brief Bounds on untrusted input.  The parser checks them while
+     * scanning and stops with an error event as soon as one is exceeded,
+     * so memory and time spent on a file are bounded.  All bounds are
+     * unlimited by default.
      */
-    parser(const std::string &filename, std::istream &in);
+    struct limits {
+        enum kind {
+            LIMIT_NONE,
+            /// Bytes of input.
+            LIMIT_BYTES,
+            /// Bytes of a section name.
+            LIMIT_SECTION,
+            /// Bytes of a parameter name.
+            LIMIT_KEY,
+            /// Bytes of a value or of an include path before trailing
+            /// blanks are trimmed.
+            LIMIT_VALUE,
+            /// Sections, parameters and include directives.
+            LIMIT_ENTRIES,
+            /// Nesting of included files, enforced by loader.
+            LIMIT_INCLUDE_DEPTH
+        };
+
+        static const std::size_t unlimited = static_cast<std::size_t>(-1);
+
+        std::size_t max_bytes;
+        std::size_t max_section;
+        std::size_t max_key;
+        std::size_t max_value;
+        std::size_t max_entries;
+        std::size_t max_include_depth;
+
+        limits()
+            : max_bytes(unlimited)
+            , max_section(unlimited)
+            , max_key(unlimited)
+            , max_value(unlimited)
+            , max_entries(unlimited)
+            , max_include_depth(unlimited)
+        {}
+    };
+
+    /// State of UTF-8 validation between input blocks.
+    struct utf8_state {
+        /// Number of continuation bytes still expected.
+        unsigned need;
+        /// Range of the next continuation byte.
+        unsigned char lo, hi;
+    };
+};
+
+/**
+ * @brief Stores tokens in the std::string values of parser_base::event.
+ *
+ * A token storage is the part of parser_machine that differs between
+ * parsers: it builds tokens out of input bytes and formats error
+ * messages.
+ */
+class string_tokens {
+public:
+    typedef parser_base::event event;
+
+    explicit string_tokens(const std::string &filename = std::string())
+        : filename_(filename)
+    {}
+
+    void set_filename(const std::string &filename) {
+        filename_.assign(filename);
+    }
+
+    /// Starts an empty token at the input byte \p at.
+    void clear(event &e, const char *) { e.value.clear(); }
+    std::size_t size(const event &e) const { return e.value.size(); }
+    const char *data(const event &e) const { return e.value.data(); }
+    /// Appends the input byte \p c found at \p p.
+    void take(event &e, char c, const char *) { e.value.push_back(c); }
+    /// Appends the input bytes [\p first, \p last).
+    void append(event &e, const char *first, const char *last) {
+        e.value.append(first, last);
+    }
+    /// Appends a byte that is not in the input as is, such as the
+    /// character denoted by an escape sequence.
+    void put(event &e, char c) { e.value.push_back(c); }
+    void truncate(event &e, std::size_t n) { e.value.erase(n); }
+    /// Cuts the token after \p n bytes, the rest starts the next token
+    /// of the same value (see resume()).
+    void hold(event &e, std::size_t n) {
+        held_.assign(e.value, n, std::string::npos);
+        e.value.erase(n);
+    }
+    /// Starts a token with the bytes held back by hold().
+    void resume(event &e) {
+        e.value.swap(held_);
+        held_.clear();
+    }
+    /// Tokens never outgrow their storage.
+    bool overflow() const { return false; }
+    void reset() { held_.clear(); }
+
+    /// Makes \p e the error \p message at \p line and \p column.
+    void error(event &e, std::size_t line, std::size_t column,
+               const char *message) const;
+
+#if __cplusplus >= 201103L
+    void swap(string_tokens &other) {
+        filename_.swap(other.filename_);
+        held_.swap(other.held_);
+    }
+#endif
+
+private:
+    std::string filename_;
+    /// Bytes of the value read but not emitted yet.
+    std::string held_;
+};
+
+/**
+ * @brief Finite state machine of the parsers, parameterized by the
+ * token storage.
+ *
+ * The machine scans an input buffer that is refilled from a stream or
+ * consists of a single block of memory.  Tokens are built by \p Tokens,
+ * see string_tokens for the operations it provides.  basic_parser,
+ * basic_fixed_parser and basic_resource_parser are this machine with
+ * different token storages, so they accept the same grammar, produce the
+ * same events and support the same settings.
+ *
+ * The library provides machines of default_dialect and relaxed_dialect;
+ * other dialects need an explicit instantiation next to the
+ * implementation.
+ */
+template <typename Dialect, typename Tokens>
+class parser_machine : public parser_base {
+public:
+    typedef Dialect dialect;
+    typedef typename Tokens::event event;
 
     /**
-     * @brief Retrieves next parser event from the input stream.
+     * @brief Retrieves next parser event from the input.
      * @param e event to modify
      * @return true if a useful event was retrieved,
      *         false on error or end of stream
      */
     bool advance(event &e);
 
+    /**
+     * @brief Returns counters collected since construction.
+     */
+    const stats &statistics() const;
+
+    /**
+     * @brief Enables validation of UTF-8 encoding of the input.  Input
+     * is validated block by block as it is read; the first invalid
+     * sequence produces an error event whose offset is the offset of the
+     * offending byte.  A leading UTF-8 byte order mark is always skipped.
+     */
+    void set_validate_utf8(bool validate);
+
+    /**
+     * @brief Makes the parser emit values longer than \p size bytes in
+     * parts, so that the parser never holds a whole large value.  The
+     * value is delivered as EVENT_VALUE_PART events followed by an
+     * EVENT_VALUE with the rest; the concatenation of their values is the
+     * complete value.  Parts have the offset of the value and zero
+     * length, the final event has the offset and the length of the whole
+     * value.  A part of an unquoted value does not end with blanks,
+     * which are held back because trailing blanks are trimmed.  Zero,
+     * the default, disables splitting.
+     */
+    void set_value_chunk_size(std::size_t size);
+
+    /**
+     * @brief Sets bounds on the input, kept across resets.
+     */
+    void set_limits(const limits &l);
+
+    /**
+     * @brief Restores the default settings: no UTF-8 validation, no value
+     * chunks and no limits.
+     */
+    void reset_settings();
+
+    /**
+     * @brief Returns the bound that stopped parsing or LIMIT_NONE.
+     */
+    limits::kind exceeded_limit() const { return exceeded_; }
+
+    /**
+     * @brief Declares that the input starts at byte \p offset and line
+     * \p line of a larger file, so that offsets of events and positions
+     * in error messages refer to that file.  Must be called before the
+     * first event is retrieved.
+     */
+    void set_origin(std::size_t offset, std::size_t line);
+
+    /**
+     * @brief Returns line and column of the next unread byte.  Only byte
+     * offsets are tracked while parsing, positions are computed on
+     * demand from the line counts of the buffers read so far.
+     */
+    std::size_t line() const;
+    std::size_t column() const;
+
+protected:
+    /**
+     * @brief Constructs machine reading the stream \p in, or without
+     * input if \p in is null.
+     */
+    parser_machine(std::istream *in, const Tokens &tokens);
+
+    /**
+     * @brief Constructs machine reading the block [\p data, \p data +
+     * \p size), which must outlive it.
+     */
+    parser_machine(const char *data, std::size_t size, const Tokens &tokens);
+
+#if __cplusplus >= 201103L
+    parser_machine(parser_machine &&other);
+    parser_machine &operator=(parser_machine &&other);
+#endif
+
+    /**
+     * @brief Starts parsing the stream \p in from the beginning.
+     */
+    void restart(std::istream *in);
+
+    Tokens tokens_;
+
 private:
     // noncopyable
-    parser(const parser &);
-    parser &operator=(const parser &);
+    parser_machine(const parser_machine &);
+    parser_machine &operator=(const parser_machine &);
 
+    void reset_state();
     char get_char();
-    void put_back(char);
+    void put_back();
+    bool fill();
+    void check_utf8();
+    std::size_t position() const { return base_ + (cur_ - begin_); }
+    void trim_right(event &);
 
     bool advance_gen(event &);
     bool advance_section(event &);
     bool advance_param(event &);
     bool advance_value(event &);
+    bool advance_plain(event &);
+    bool advance_quoted(event &);
+    bool advance_directive(event &);
     bool advance_eof(event &);
 
     bool handle_eof(event &);
+    bool stop_early(event &);
+    bool continue_line();
     bool skip_ws();
     bool skip_comment(event &);
+    void resume_value(event &);
+    bool emit_part(event &, bool trim);
     void unexpected_token(event &, const char *);
+    bool exceed(event &, limits::kind, const char *what, std::size_t max);
+    void report(event &, const char *message);
     void check_lf();
-    void handle_new_line();
+    void locate(const char *, std::size_t &line, std::size_t &column) const;
 
-    typedef bool (parser::*state)(event &);
+    typedef bool (parser_machine::*state)(event &);
 
-    std::istream &in_;
-    std::string filename_;
+    std::istream *in_;
+    /// Block of memory input.
+    const char *block_;
+    std::size_t block_size_;
     state state_;
-    std::size_t line_;
-    std::size_t column_;
+    /// Line number of the buffer start.
+    std::size_t line_base_;
+    /// Offset of the start of the line containing the buffer start.
+    std::size_t line_start_;
+    /// The previous buffer ended with a carriage return.
+    bool pending_cr_;
+    /// Buffer of stream input, allocated once there is a stream.
+    std::vector<char> buf_;
+    /// Input buffer, [cur_, end_) is not consumed yet.
+    const char *begin_;
+    const char *cur_;
+    const char *end_;
+    /// Offset of the buffer start in the input stream.
+    std::size_t base_;
+    bool eof_;
+    bool validate_utf8_;
+    utf8_state utf8_;
+    /// Offset of the first invalid UTF-8 byte.
+    std::size_t utf8_error_;
+    std::size_t chunk_size_;
+    limits limits_;
+    limits::kind exceeded_;
+    /// Number of entries seen so far.
+    std::size_t entries_;
+    /// Number of bytes read from the input.
+    std::size_t read_;
+    /// The input was cut at limits_.max_bytes.
+    bool cut_;
+    /// The early end of input has been reported.
+    bool stopped_;
+    /// State of the value being emitted in parts.
+    std::size_t value_offset_;
+    std::size_t value_folded_;
+    std::size_t value_emitted_;
+    char quote_;
+    // The counters are members in every build, so the layout of the
+    // parser does not depend on how the library was built.
+    class state_scope;
+
+    stats stats_;
+    stats::state_kind stat_state_;
+    uint64_t stat_mark_;
+};
+
+/**
+ * @brief Pull .ini file parser implementation.
+ *
+ * The library provides parsers of default_dialect and relaxed_dialect;
+ * other dialects need an explicit instantiation next to the
+ * implementation.
+ */
+template <typename Dialect>
+class basic_parser : public parser_machine<Dialect, string_tokens> {
+public:
+    /**
+     * @brief Constructs parser without input, it produces no events until
+     * reset() is called.
+     */
+    basic_parser();
+
+    /**
+     * @brief Constructs parser of input stream \p in.
+     */
+    basic_parser(std::istream &in);
+
+    /**
+     * @brief Constructs parser of input stream \p in assuming that
+     * filename is \p filename.
+     */
+    basic_parser(const std::string &filename, std::istream &in);
+
+#if __cplusplus >= 201103L
+    /**
+     * @brief Takes over the state and the buffer of \p other, which is
+     * left without input.
+     */
+    basic_parser(basic_parser &&other);
+    basic_parser &operator=(basic_parser &&other);
+#endif
+
+    /**
+     * @brief Starts parsing the stream \p in named \p filename from the
+     * beginning.  The input buffer is reused, settings such as UTF-8
+     * validation are kept.
+     */
+    void reset(std::istream &in, const std::string &filename);
+
+private:
+    typedef parser_machine<Dialect, string_tokens> machine;
 };
 
-bool operator==(const parser::event &, const parser::event &);
+typedef basic_parser<default_dialect> parser;
+
+bool operator==(const parser_base::event &, const parser_base::event &);
 
-std::ostream &operator<<(std::ostream &, const parser::event &);
+std::ostream &operator<<(std::ostream &, const parser_base::event &);
 }
 }
 
@@ -0,0 +1,93 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_PARSER_POOL_HPP
+#define CONFIG_INI_PARSER_POOL_HPP
+
+#include "config/ini/parser.hpp"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Thread-safe pool of parsers.
+ *
+ * Released parsers keep their input buffers, so loaders of many small
+ * files running in several threads reuse warmed-up parsers instead of
+ * allocating new ones.
+ */
+class parser_pool {
+public:
+    /**
+     * @brief Parser borrowed from a pool for the lifetime of the lease.
+     */
+    class lease {
+    public:
+        lease(parser_pool &pool, std::istream &in,
+              const std::string &filename);
+        ~lease();
+
+        parser &operator*() const { return *parser_; }
+        parser *operator->() const { return parser_; }
+
+    private:
+        // noncopyable
+        lease(const lease &);
+        lease &operator=(const lease &);
+
+        parser_pool &pool_;
+        parser *parser_;
+    };
+
+    /**
+     * @brief Constructs pool keeping at most \p max_idle released parsers.
+     */
+    explicit parser_pool(std::size_t max_idle = 16);
+    ~parser_pool();
+
+    /**
+     * @brief Returns a parser of the stream \p in named \p filename, an
+     * idle one if there is any.  The parser has default settings.
+     */
+    parser *acquire(std::istream &in, const std::string &filename);
+
+    /**
+     * @brief Returns \p p to the pool.
+     */
+    void release(parser *p);
+
+    /**
+     * @brief Returns number of idle parsers.
+     */
+    std::size_t idle() const;
+
+private:
+    // noncopyable
+    parser_pool(const parser_pool &);
+    parser_pool &operator=(const parser_pool &);
+
+    std::size_t max_idle_;
+    std::vector<parser *> idle_;
+    mutable pthread_mutex_t mutex_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_READAHEAD_HPP
+#define CONFIG_INI_READAHEAD_HPP
+
+#include <stdint.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Input stream buffer reading a file ahead in a background thread.
+ *
+ * A producer thread reads the file into a ring of fixed-size blocks while
+ * the reader consumes earlier ones, so the latency of reads (e.g. from a
+ * network file system) overlaps with parsing.  Blocks are handed over
+ * through two atomic counters; a side only sleeps in the kernel when the
+ * ring is empty or full.  Wrap the buffer in a std::istream to feed a
+ * parser:
+ *
+ *     readahead_buf buf;
+ *     if (buf.open(path)) {
+ *         std::istream in(&buf);
+ *         parser p(path, in);
+ *         ...
+ *     }
+ *
+ * The buffer must be read by one thread at a time.
+ */
+class readahead_buf : public std::streambuf {
+public:
+    explicit readahead_buf(std::size_t block_size = 64 * 1024,
+                           std::size_t blocks = 4);
+    ~readahead_buf();
+
+    /**
+     * @brief Opens the file \p path and starts reading it ahead.
+     * @return true on success, false otherwise (see error())
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief Stops the producer and closes the file.
+     */
+    void close();
+
+    bool is_open() const { return fd_ >= 0; }
+
+    /**
+     * @brief Returns description of the failure to open the file or of a
+     * read error, which ends the input early.
+     */
+    const std::string &error() const { return error_; }
+
+protected:
+    int_type underflow();
+
+private:
+    // noncopyable
+    readahead_buf(const readahead_buf &);
+    readahead_buf &operator=(const readahead_buf &);
+
+    static void *run(void *self);
+    void produce();
+
+    std::size_t block_size_;
+    std::vector<char> ring_;
+    /// Number of bytes in each block, zero marks the end of input.
+    std::vector<std::size_t> sizes_;
+    std::string path_;
+    int fd_;
+    pthread_t thread_;
+    /// Blocks filled by the producer and released by the reader, both
+    /// counting up from zero.
+    uint32_t head_;
+    uint32_t tail_;
+    /// Changed whenever the producer may have to wake up.
+    uint32_t space_;
+    int stop_;
+    /// The reader (producer) announced that it sleeps on its futex.
+    uint32_t reader_waits_;
+    uint32_t producer_waits_;
+    /// errno of the read that ended the input.
+    int read_errno_;
+    /// The reader holds the block at tail_.
+    bool holding_;
+    std::string error_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_RESOURCE_PARSER_HPP
+#define CONFIG_INI_RESOURCE_PARSER_HPP
+
+#include "config/ini/memory.hpp"
+#include "config/ini/parser.hpp"
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Stores tokens in strings allocated from a memory_resource, see
+ * string_tokens for the operations.
+ */
+class resource_tokens {
+public:
+    /**
+     * @brief Parser event whose value is allocated from the resource the
+     * event is constructed with.
+     */
+    struct event {
+        explicit event(memory_resource *r = new_delete_resource())
+            : type(parser_base::EVENT_END)
+            , value(r)
+            , offset(0)
+            , length(0)
+        {}
+
+        parser_base::event_type type;
+        string value;
+        /// Byte offset of the token in the input stream.
+        std::size_t offset;
+        /// Number of source bytes the token occupies.
+        std::size_t length;
+    };
+
+    resource_tokens(const std::string &filename, memory_resource *r)
+        : filename_(filename.data(), filename.size(), r)
+        , held_(r)
+    {}
+
+    /// The copy stays in the resource of \p other, unlike copies of
+    /// strings.
+    resource_tokens(const resource_tokens &other)
+        : filename_(other.filename_.data(), other.filename_.size(),
+                    other.resource())
+        , held_(other.held_.data(), other.held_.size(), other.resource())
+    {}
+
+    void set_filename(const std::string &filename) {
+        filename_.assign(filename.data(), filename.size());
+    }
+
+    void clear(event &e, const char *) { e.value.clear(); }
+    std::size_t size(const event &e) const { return e.value.size(); }
+    const char *data(const event &e) const { return e.value.data(); }
+    void take(event &e, char c, const char *) { e.value.push_back(c); }
+    void append(event &e, const char *first, const char *last) {
+        e.value.append(first, last);
+    }
+    void put(event &e, char c) { e.value.push_back(c); }
+    void truncate(event &e, std::size_t n) { e.value.erase(n); }
+
+    void hold(event &e, std::size_t n) {
+        held_.assign(e.value, n, string::npos);
+        e.value.erase(n);
+    }
+
+    void resume(event &e) {
+        // The event may use another resource, so the bytes are copied
+        // rather than swapped.
+        e.value.assign(held_);
+        held_.clear();
+    }
+
+    bool overflow() const { return false; }
+    void reset() { held_.clear(); }
+
+    void error(event &e, std::size_t line, std::size_t column,
+               const char *message) const;
+
+    memory_resource *resource() const {
+        return held_.get_allocator().resource();
+    }
+
+#if __cplusplus >= 201103L
+    void swap(resource_tokens &other) {
+        filename_.swap(other.filename_);
+        held_.swap(other.held_);
+    }
+#endif
+
+private:
+    string filename_;
+    /// Bytes of the value read but not emitted yet.
+    string held_;
+};
+
+/**
+ * @brief Pull .ini file parser allocating event values from a
+ * memory_resource.
+ *
+ * The parser is the state machine of basic_parser, so it accepts the
+ * same grammar, produces the same events and supports the same settings.
+ * Values are built in the event, which is constructed with the resource
+ * to allocate from:
+ *
+ * @code
+ * monotonic_buffer_resource arena;
+ * resource_parser p("app.ini", in, &arena);
+ * resource_parser::event e(&arena);
+ * while (p.advance(e)) {
+ *     ...
+ * }
+ * @endcode
+ *
+ * Error messages and values emitted in parts are composed in the
+ * resource as well.  Only the input buffer, allocated once per parser,
+ * comes from the global heap.
+ */
+template <typename Dialect>
+class basic_resource_parser
+    : public parser_machine<Dialect, resource_tokens> {
+public:
+    typedef resource_tokens::event event;
+
+    /**
+     * @brief Constructs parser without input, it produces no events until
+     * reset() is called.
+     */
+    explicit basic_resource_parser(
+        memory_resource *r = new_delete_resource());
+
+    /**
+     * @brief Constructs parser of input stream \p in named \p filename.
+     * The resource must outlive the parser.
+     */
+    basic_resource_parser(const std::string &filename, std::istream &in,
+                          memory_resource *r = new_delete_resource());
+
+    /**
+     * @brief Starts parsing the stream \p in named \p filename from the
+     * beginning.  Settings are kept.
+     */
+    void reset(std::istream &in, const std::string &filename);
+
+    memory_resource *get_resource() const {
+        return this->tokens_.resource();
+    }
+
+private:
+    // noncopyable
+    basic_resource_parser(const basic_resource_parser &);
+    basic_resource_parser &operator=(const basic_resource_parser &);
+
+    typedef parser_machine<Dialect, resource_tokens> machine;
+};
+
+typedef basic_resource_parser<default_dialect> resource_parser;
+}
+}
+
+#endif
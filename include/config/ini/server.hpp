@@ -0,0 +1,141 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_SERVER_HPP
+#define CONFIG_INI_SERVER_HPP
+
+#include "config/ini/document.hpp"
+#include "config/ini/loader.hpp"
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+/**
+ * @brief Serves a configuration over a Unix domain socket.
+ *
+ * The configuration is loaded with loader, so includes are resolved, and
+ * reloaded whenever a file in the directory of any loaded file changes.
+ * A failed reload keeps the previous document.  Each successful load
+ * increments the generation reported in every response.
+ *
+ * Clients send batches of get and list requests (see client) and may
+ * pipeline them.  All connections are served by one thread with an epoll
+ * event loop.  A connection is not read while too many of its responses
+ * are unsent, so a client that does not read cannot make the server
+ * buffer without bound.
+ */
+class server {
+public:
+    /**
+     * @brief Constructs server of the configuration file \p path.
+     */
+    explicit server(const std::string &path,
+                    const document::options &opts = document::options());
+    ~server();
+
+    /**
+     * @brief Loads the configuration and starts listening on the socket
+     * \p socket_path, replacing a stale socket file.
+     * @return true on success, false otherwise (see error())
+     */
+    bool listen(const std::string &socket_path);
+
+    /**
+     * @brief Waits up to \p timeout_ms milliseconds (forever if negative)
+     * and handles ready events.
+     * @return false on a fatal error (see error())
+     */
+    bool run_once(int timeout_ms);
+
+    /**
+     * @brief Handles events until stop() is called.
+     */
+    bool run();
+
+    /**
+     * @brief Makes run() return.  Safe to call from other threads and
+     * from signal handlers.
+     */
+    void stop();
+
+    /**
+     * @brief Reloads the configuration.
+     */
+    bool reload();
+
+    uint64_t generation() const { return generation_; }
+
+    const document &get_document() const { return doc_; }
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    struct connection {
+        std::string in;
+        std::string out;
+        bool writing;
+        /// Reading stopped because too much output is pending.
+        bool paused;
+        /// The peer shut down its side, the connection is closed once
+        /// the pending output is sent.
+        bool eof;
+    };
+
+    // noncopyable
+    server(const server &);
+    server &operator=(const server &);
+
+    void accept_all();
+    void handle(int fd);
+    bool serve(int fd, connection &c);
+    bool handle_frame(const char *body, std::size_t size, std::string &out);
+    bool flush(int fd, connection &c);
+    void close_connection(int fd);
+    void watch();
+    bool read_changes();
+    bool fail(const char *what, const std::string &name);
+
+    std::string path_;
+    std::string socket_path_;
+    std::string error_;
+    document doc_;
+    loader loader_;
+    uint64_t generation_;
+    int epoll_;
+    int listen_;
+    int wakeup_;
+    int inotify_;
+    /// Set by stop(), possibly from another thread, accessed atomically.
+    bool stopped_;
+    /// Watched directories by watch descriptor.
+    std::map<int, std::string> watches_;
+    /// Indices of the parameters of each section in doc_.params().
+    std::vector<std::vector<std::size_t> > section_params_;
+    /// Canonical paths of the loaded files.
+    std::set<std::string> files_;
+    std::map<int, connection> connections_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,154 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_SHARED_DOCUMENT_HPP
+#define CONFIG_INI_SHARED_DOCUMENT_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace config {
+namespace ini {
+
+class document;
+
+/**
+ * @brief Publishes documents into POSIX shared memory.
+ *
+ * Every published generation is compiled into a flat, position
+ * independent image stored in its own shared memory object
+ * "<name>.<generation>".  A small control object "<name>" holds the
+ * current generation behind a sequence lock, so readers never observe a
+ * partially published document.  The previous generation is unlinked
+ * after the switch; readers that still map it keep a valid mapping.
+ *
+ * There must be at most one publisher for a name at a time.
+ */
+class shared_publisher {
+public:
+    /**
+     * @brief Constructs publisher for the shared memory name \p name,
+     * which must start with a slash and contain no other slashes.
+     */
+    explicit shared_publisher(const std::string &name);
+    ~shared_publisher();
+
+    /**
+     * @brief Publishes \p doc as the next generation.
+     * @return true on success, false otherwise (see error())
+     */
+    bool publish(const document &doc);
+
+    /**
+     * @brief Unlinks the control object and the current generation.
+     */
+    void remove();
+
+    /**
+     * @brief Returns generation of the last published document or 0.
+     */
+    uint64_t generation() const { return generation_; }
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    shared_publisher(const shared_publisher &);
+    shared_publisher &operator=(const shared_publisher &);
+
+    bool map_control();
+    bool fail(const char *what, const std::string &name);
+
+    std::string name_;
+    std::string error_;
+    void *control_;
+    uint64_t generation_;
+};
+
+/**
+ * @brief Read-only view of a document published by shared_publisher.
+ *
+ * Lookups are performed directly in the shared image, nothing is parsed
+ * or copied except the returned values.  refresh() is cheap when the
+ * generation has not changed: it reads the control header only.
+ */
+class shared_document {
+public:
+    /**
+     * @brief Constructs reader of the shared memory name \p name.  No
+     * memory is mapped until refresh() is called.
+     */
+    explicit shared_document(const std::string &name);
+    ~shared_document();
+
+    /**
+     * @brief Maps the current generation if it differs from the mapped
+     * one.  Gives up with an error if the publisher keeps changing the
+     * control header during a bounded number of reads.
+     * @return true if a document is mapped, false otherwise (see error())
+     */
+    bool refresh();
+
+    /**
+     * @brief Returns generation of the mapped document or 0.
+     */
+    uint64_t generation() const { return generation_; }
+
+    /**
+     * @brief Stores into \p value the value of the parameter \p name in
+     * the section \p section, the last one for lists.
+     * @return false if there is no such parameter
+     */
+    bool get(const std::string &section, const std::string &name,
+             std::string &value) const;
+
+    /**
+     * @brief Appends to \p values all values of the parameter \p name in
+     * the section \p section.
+     * @return number of appended values
+     */
+    std::size_t get_all(const std::string &section, const std::string &name,
+                        std::vector<std::string> &values) const;
+
+    /**
+     * @brief Returns description of the last error.
+     */
+    const std::string &error() const { return error_; }
+
+private:
+    shared_document(const shared_document &);
+    shared_document &operator=(const shared_document &);
+
+    bool map_control();
+    bool map_image(uint64_t generation, uint64_t size);
+    void unmap_image();
+    const void *find(const std::string &section,
+                     const std::string &name) const;
+    bool fail(const char *what, const std::string &name);
+
+    std::string name_;
+    std::string error_;
+    const void *control_;
+    const char *image_;
+    std::size_t image_size_;
+    uint64_t generation_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,257 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail POSIX implementation of the write-fsync-rename-fsync sequence.
+ * The content is streamed through a buffer of configurable size straight
+ * into the file descriptor, so large documents are never copied into an
+ * intermediate string.
+ */
+
+#include "config/ini/atomic_writer.hpp"
+#include "config/ini/editable_document.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace config {
+namespace ini {
+
+namespace {
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Output buffer writing directly into a file descriptor.
+ */
+class fd_buf : public std::streambuf {
+public:
+    fd_buf(int fd, std::size_t size)
+        : fd_(fd)
+        , errno_(0)
+        , buf_(size ? size : 1)
+    {
+        setp(&buf_[0], &buf_[0] + buf_.size());
+    }
+
+    int error() const { return errno_; }
+
+protected:
+    int_type overflow(int_type c) {
+        if (!flush())
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) {
+        // Chunks larger than the buffer bypass it altogether.
+        if (n >= static_cast<std::streamsize>(buf_.size())) {
+            return flush() && write_all(s, n) ? n : 0;
+        }
+        return std::streambuf::xsputn(s, n);
+    }
+
+    int sync() { return flush() ? 0 : -1; }
+
+private:
+    bool flush() {
+        const std::size_t n = pptr() - pbase();
+        setp(&buf_[0], &buf_[0] + buf_.size());
+        return write_all(&buf_[0], n);
+    }
+
+    bool write_all(const char *s, std::size_t n) {
+        while (n) {
+            const ssize_t written = ::write(fd_, s, n);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                errno_ = errno;
+                return false;
+            }
+            s += written;
+            n -= written;
+        }
+        return true;
+    }
+
+    int fd_;
+    int errno_;
+    std::vector<char> buf_;
+};
+
+void save_string(std::ostream &os, const void *arg) {
+    const std::string &s = *static_cast<const std::string *>(arg);
+    os.write(s.data(), s.size());
+}
+
+void save_document(std::ostream &os, const void *arg) {
+    static_cast<const editable_document *>(arg)->save(os);
+}
+
+/**
+ * Creates a new file named \p prefix followed by a random suffix, like
+ * mkstemp(3) but with the permissions \p mode, to which the kernel
+ * applies the umask.  Stores the name into \p path.
+ */
+int create_temp(const std::string &prefix, mode_t mode, std::string &path) {
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz"
+                                "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    uint32_t seed = static_cast<uint32_t>(now_ns()) ^ ::getpid();
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        path = prefix;
+        for (int i = 0; i < 6; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            path.push_back(chars[(seed >> 16) % (sizeof(chars) - 1)]);
+        }
+        const int fd = ::open(path.c_str(),
+                              O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+        if (fd >= 0 || errno != EEXIST)
+            return fd;
+    }
+    return -1;
+}
+
+std::string dir_name(const std::string &path) {
+    const std::size_t slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+}
+
+atomic_writer::atomic_writer(const std::string &path)
+    : path_(path)
+    , buffer_size_(1 << 20)
+    , sync_directory_(true)
+    , replaced_(false)
+{
+    std::memset(&timings_, 0, sizeof(timings_));
+}
+
+void atomic_writer::set_buffer_size(std::size_t size) { buffer_size_ = size; }
+
+void atomic_writer::set_sync_directory(bool sync) { sync_directory_ = sync; }
+
+bool atomic_writer::write(const std::string &content) {
+    return write_content(&save_string, &content);
+}
+
+bool atomic_writer::write(const editable_document &doc) {
+    return write_content(&save_document, &doc);
+}
+
+bool atomic_writer::write_content(save_function save, const void *arg) {
+    std::memset(&timings_, 0, sizeof(timings_));
+    error_.clear();
+    replaced_ = false;
+    const uint64_t start = now_ns();
+
+    // The temporary file must live in the same directory as the target,
+    // otherwise rename(2) is not guaranteed to be atomic.  A new file
+    // gets the permissions of files created by other programs, the umask
+    // applied to 0666; a replaced file keeps its own.
+    struct stat st;
+    const bool exists = ::stat(path_.c_str(), &st) == 0;
+    std::string tmp;
+    const int fd = create_temp(path_ + ".tmp.", 0666, tmp);
+    if (fd < 0)
+        return fail("open", tmp);
+    if (exists)
+        fchmod(fd, st.st_mode & 07777);
+    uint64_t t = now_ns();
+    timings_.open_ns = t - start;
+
+    {
+        fd_buf buf(fd, buffer_size_);
+        std::ostream os(&buf);
+        save(os, arg);
+        os.flush();
+        if (!os) {
+            errno = buf.error();
+            const bool r = fail("write", tmp);
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return r;
+        }
+    }
+    timings_.write_ns = now_ns() - t;
+
+    t = now_ns();
+    if (::fsync(fd) != 0) {
+        const bool r = fail("fsync", tmp);
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        return r;
+    }
+    timings_.fsync_ns = now_ns() - t;
+
+    if (::close(fd) != 0) {
+        const bool r = fail("close", tmp);
+        ::unlink(tmp.c_str());
+        return r;
+    }
+
+    t = now_ns();
+    if (::rename(tmp.c_str(), path_.c_str()) != 0) {
+        const bool r = fail("rename", tmp);
+        ::unlink(tmp.c_str());
+        return r;
+    }
+    timings_.rename_ns = now_ns() - t;
+    replaced_ = true;
+
+    if (sync_directory_) {
+        t = now_ns();
+        const std::string dir = dir_name(path_);
+        const int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dfd < 0)
+            return fail("open", dir);
+        const int rc = ::fsync(dfd);
+        ::close(dfd);
+        if (rc != 0)
+            return fail("fsync", dir);
+        timings_.dir_fsync_ns = now_ns() - t;
+    }
+
+    timings_.total_ns = now_ns() - start;
+    return true;
+}
+
+bool atomic_writer::fail(const char *what, const std::string &path) {
+    error_ = path + ": " + what + ": " + std::strerror(errno);
+    timings_.total_ns = 0;
+    return false;
+}
+}
+}
@@ -0,0 +1,795 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail Reading and parsing are two stages connected by a queue of
+ * file contents.  The calling thread runs the reading stage, which waits
+ * while queue_depth files are queued, so at most twice queue_depth files
+ * are held in memory.
+ *
+ * With io_uring it keeps up to queue_depth files in flight, each going
+ * through openat and statx (submitted together), then reads sized by
+ * the statx result.  A short read past the size reported by statx ends
+ * a file, other files are read until a read returns nothing.  The ring
+ * is driven through raw system calls, so liburing is not needed.
+ *
+ * Without io_uring, queue_depth threads (the caller among them) take
+ * file indices from a shared counter and read files with blocking calls.
+ */
+
+#include "config/ini/bulk_loader.hpp"
+#include "config/ini/document.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <istream>
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#if defined(IO_URING_OP_SUPPORTED) && defined(__NR_io_uring_setup) &&      \
+    defined(STATX_SIZE)
+#define CONFIG_INI_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace config {
+namespace ini {
+
+namespace {
+/**
+ * Locks the mutex for the lifetime of the object.
+ */
+class lock_guard {
+public:
+    explicit lock_guard(pthread_mutex_t &m)
+        : m_(m)
+    {
+        pthread_mutex_lock(&m_);
+    }
+
+    ~lock_guard() { pthread_mutex_unlock(&m_); }
+
+private:
+    pthread_mutex_t &m_;
+};
+
+/**
+ * Stream buffer over a string in memory, read without copying.
+ */
+class memory_buf : public std::streambuf {
+public:
+    explicit memory_buf(std::string &s) {
+        char *p = s.empty() ? 0 : &s[0];
+        setg(p, p, p + s.size());
+    }
+};
+
+std::string describe(const std::string &path, const char *op, int err) {
+    return path + ": " + op + ": " + std::strerror(err);
+}
+
+/**
+ * Parsing stage: a queue of read files drained by parser threads.
+ */
+class delivery {
+public:
+    delivery(const std::vector<std::string> &paths,
+             bulk_loader::handler &h, std::size_t workers,
+             std::size_t capacity)
+        : paths_(paths)
+        , handler_(h)
+        , capacity_(capacity)
+        , done_(false)
+    {
+        pthread_mutex_init(&mutex_, 0);
+        pthread_cond_init(&ready_, 0);
+        pthread_cond_init(&space_, 0);
+        for (std::size_t i = 0; i < workers; ++i) {
+            pthread_t t;
+            if (pthread_create(&t, 0, &delivery::run, this) != 0)
+                break;
+            threads_.push_back(t);
+        }
+    }
+
+    ~delivery() {
+        pthread_cond_destroy(&space_);
+        pthread_cond_destroy(&ready_);
+        pthread_mutex_destroy(&mutex_);
+    }
+
+    /**
+     * Queues contents of the file \p index, taking \p data, or the
+     * \p error that prevented reading it.  Waits while the queue is
+     * full, unless there are no parser threads to drain it.
+     */
+    void push(std::size_t index, std::string &data, const std::string &error) {
+        lock_guard lock(mutex_);
+        while (queue_.size() >= capacity_ && !threads_.empty())
+            pthread_cond_wait(&space_, &mutex_);
+        queue_.push_back(item());
+        queue_.back().index = index;
+        queue_.back().data.swap(data);
+        queue_.back().error = error;
+        pthread_cond_signal(&ready_);
+    }
+
+    /**
+     * Waits until all queued files are parsed.
+     */
+    void finish() {
+        {
+            lock_guard lock(mutex_);
+            done_ = true;
+            pthread_cond_broadcast(&ready_);
+        }
+        if (threads_.empty())
+            work();
+        for (std::size_t i = 0; i < threads_.size(); ++i)
+            pthread_join(threads_[i], 0);
+    }
+
+private:
+    struct item {
+        std::size_t index;
+        std::string data;
+        std::string error;
+    };
+
+    // noncopyable
+    delivery(const delivery &);
+    delivery &operator=(const delivery &);
+
+    static void *run(void *self) {
+        static_cast<delivery *>(self)->work();
+        return 0;
+    }
+
+    void work() {
+        parser p;
+        item it;
+        for (;;) {
+            {
+                lock_guard lock(mutex_);
+                while (queue_.empty() && !done_)
+                    pthread_cond_wait(&ready_, &mutex_);
+                if (queue_.empty())
+                    return;
+                it.index = queue_.front().index;
+                it.data.swap(queue_.front().data);
+                it.error.swap(queue_.front().error);
+                queue_.pop_front();
+                pthread_cond_signal(&space_);
+            }
+            const std::string &path = paths_[it.index];
+            if (!it.error.empty()) {
+                handler_.fail(it.index, path, it.error);
+                continue;
+            }
+            memory_buf buf(it.data);
+            std::istream in(&buf);
+            p.reset(in, path);
+            handler_.parse(it.index, path, p);
+        }
+    }
+
+    const std::vector<std::string> &paths_;
+    bulk_loader::handler &handler_;
+    std::deque<item> queue_;
+    /// Files read but not parsed yet are bounded by this.
+    std::size_t capacity_;
+    bool done_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t ready_;
+    pthread_cond_t space_;
+    std::vector<pthread_t> threads_;
+};
+
+/**
+ * Tells whether a short read ended a file of the \p expected size.
+ * Files reporting no size (e.g. in procfs) are read until a read returns
+ * nothing.
+ */
+bool at_end(std::size_t expected, std::size_t size, std::size_t capacity) {
+    return expected > 0 && size >= expected && size < capacity;
+}
+
+/**
+ * Reads the file \p path into \p data with blocking calls.
+ * @return empty string on success, error description otherwise
+ */
+std::string read_file(const std::string &path, std::string &data) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return describe(path, "open", errno);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const int err = errno;
+        ::close(fd);
+        return describe(path, "stat", err);
+    }
+    const std::size_t expected = S_ISREG(st.st_mode) ? st.st_size : 0;
+    data.resize(expected + 4096);
+    std::size_t size = 0;
+    for (;;) {
+        const ssize_t n = ::read(fd, &data[size], data.size() - size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            const int err = errno;
+            ::close(fd);
+            return describe(path, "read", err);
+        }
+        size += n;
+        if (n == 0 || at_end(expected, size, data.size()))
+            break;
+        if (size == data.size())
+            data.resize(2 * size);
+    }
+    ::close(fd);
+    data.resize(size);
+    return std::string();
+}
+
+/**
+ * Reading stage without io_uring.
+ */
+class reader_pool {
+public:
+    reader_pool(const std::vector<std::string> &paths, delivery &out)
+        : paths_(paths)
+        , out_(out)
+        , next_(0)
+    {}
+
+    void run(std::size_t threads) {
+        std::vector<pthread_t> started;
+        for (std::size_t i = 1; i < threads; ++i) {
+            pthread_t t;
+            if (pthread_create(&t, 0, &reader_pool::start, this) != 0)
+                break;
+            started.push_back(t);
+        }
+        read();
+        for (std::size_t i = 0; i < started.size(); ++i)
+            pthread_join(started[i], 0);
+    }
+
+private:
+    static void *start(void *self) {
+        static_cast<reader_pool *>(self)->read();
+        return 0;
+    }
+
+    void read() {
+        std::string data;
+        for (;;) {
+            const std::size_t i =
+                __atomic_fetch_add(&next_, 1, __ATOMIC_RELAXED);
+            if (i >= paths_.size())
+                return;
+            const std::string error = read_file(paths_[i], data);
+            out_.push(i, data, error);
+        }
+    }
+
+    const std::vector<std::string> &paths_;
+    delivery &out_;
+    std::size_t next_;
+};
+
+#ifdef CONFIG_INI_HAS_IO_URING
+/**
+ * Minimal io_uring instance driven through raw system calls.
+ */
+class uring {
+public:
+    uring()
+        : fd_(-1)
+        , sq_ptr_(MAP_FAILED)
+        , cq_ptr_(MAP_FAILED)
+        , sqes_(static_cast<io_uring_sqe *>(MAP_FAILED))
+        , sq_len_(0)
+        , cq_len_(0)
+        , sqes_len_(0)
+        , tail_(0)
+        , flushed_(0)
+        , reaped_(0)
+    {}
+
+    ~uring() {
+        if (sqes_ != MAP_FAILED)
+            ::munmap(sqes_, sqes_len_);
+        if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+            ::munmap(cq_ptr_, cq_len_);
+        if (sq_ptr_ != MAP_FAILED)
+            ::munmap(sq_ptr_, sq_len_);
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    /**
+     * Sets up a ring of \p entries submissions and checks that the
+     * operations used by the loader are supported.
+     */
+    bool init(unsigned entries, std::string &error) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = ::syscall(__NR_io_uring_setup, entries, &p);
+        if (fd_ < 0) {
+            error = std::string("io_uring_setup: ") + std::strerror(errno);
+            return false;
+        }
+        sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+        sq_ptr_ = map(sq_len_, IORING_OFF_SQ_RING);
+        cq_ptr_ = single ? sq_ptr_ : map(cq_len_, IORING_OFF_CQ_RING);
+        sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(map(sqes_len_, IORING_OFF_SQES));
+        if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED ||
+            sqes_ == MAP_FAILED) {
+            error = std::string("io_uring mmap: ") + std::strerror(errno);
+            return false;
+        }
+        char *sq = static_cast<char *>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        char *cq = static_cast<char *>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+        tail_ = flushed_ = *sq_tail_;
+        return probe(error);
+    }
+
+    /**
+     * Returns a cleared submission entry or null if the queue is full.
+     */
+    io_uring_sqe *get_sqe() {
+        const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (tail_ - head >= sq_entries_)
+            return 0;
+        const unsigned i = tail_++ & sq_mask_;
+        sq_array_[i] = i;
+        std::memset(&sqes_[i], 0, sizeof(sqes_[i]));
+        return &sqes_[i];
+    }
+
+    /**
+     * Submits prepared entries and waits for at least one completion.
+     */
+    bool submit_and_wait(std::string &error) {
+        __atomic_store_n(sq_tail_, tail_, __ATOMIC_RELEASE);
+        for (;;) {
+            const unsigned pending = tail_ - flushed_;
+            const int n = ::syscall(__NR_io_uring_enter, fd_, pending, 1,
+                                    IORING_ENTER_GETEVENTS, 0, 0);
+            if (n >= 0) {
+                flushed_ += n;
+                return true;
+            }
+            if (errno != EINTR) {
+                error = std::string("io_uring_enter: ") + std::strerror(errno);
+                return false;
+            }
+        }
+    }
+
+    /**
+     * Returns the oldest unseen completion or null.
+     */
+    io_uring_cqe *peek() {
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        return *cq_head_ == tail ? 0 : &cqes_[*cq_head_ & cq_mask_];
+    }
+
+    void seen() {
+        __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE);
+        ++reaped_;
+    }
+
+    /**
+     * Returns number of submitted entries whose completions are not seen.
+     */
+    unsigned in_flight() const { return flushed_ - reaped_; }
+
+    /**
+     * Waits for a completion without submitting anything.
+     */
+    bool wait(std::string &error) {
+        for (;;) {
+            if (::syscall(__NR_io_uring_enter, fd_, 0, 1,
+                          IORING_ENTER_GETEVENTS, 0, 0) >= 0)
+                return true;
+            if (errno != EINTR) {
+                error = std::string("io_uring_enter: ") + std::strerror(errno);
+                return false;
+            }
+        }
+    }
+
+private:
+    // noncopyable
+    uring(const uring &);
+    uring &operator=(const uring &);
+
+    void *map(std::size_t len, off_t offset) {
+        return ::mmap(0, len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, offset);
+    }
+
+    bool probe(std::string &error) {
+        const unsigned ops = 256;
+        std::vector<char> buf(sizeof(io_uring_probe) +
+                              ops * sizeof(io_uring_probe_op));
+        io_uring_probe *p = reinterpret_cast<io_uring_probe *>(&buf[0]);
+        if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, p,
+                      ops) < 0) {
+            error = std::string("io_uring probe: ") + std::strerror(errno);
+            return false;
+        }
+        const unsigned needed[] = {IORING_OP_OPENAT, IORING_OP_STATX,
+                                   IORING_OP_READ};
+        for (std::size_t i = 0; i < sizeof(needed) / sizeof(needed[0]);
+             ++i) {
+            if (needed[i] >= p->ops_len ||
+                !(p->ops[needed[i]].flags & IO_URING_OP_SUPPORTED)) {
+                error = "io_uring: file operations are not supported";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int fd_;
+    void *sq_ptr_;
+    void *cq_ptr_;
+    io_uring_sqe *sqes_;
+    std::size_t sq_len_;
+    std::size_t cq_len_;
+    std::size_t sqes_len_;
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe *cqes_;
+    /// Submission entries prepared and handed to the kernel, completions
+    /// seen.
+    unsigned tail_;
+    unsigned flushed_;
+    unsigned reaped_;
+};
+
+/**
+ * Reading stage with io_uring.
+ */
+class uring_reader {
+public:
+    uring_reader(const std::vector<std::string> &paths, delivery &out,
+                 uring &ring)
+        : paths_(paths)
+        , out_(out)
+        , ring_(ring)
+        , next_(0)
+        , active_(0)
+    {}
+
+    bool run(std::size_t depth, std::string &error) {
+        slots_.resize(std::min(depth, paths_.size()));
+        for (std::size_t i = 0; i < slots_.size(); ++i)
+            start(i);
+        while (active_ > 0) {
+            if (!ring_.submit_and_wait(error)) {
+                abandon();
+                return false;
+            }
+            while (io_uring_cqe *cqe = ring_.peek()) {
+                const uint64_t data = cqe->user_data;
+                const int res = cqe->res;
+                ring_.seen();
+                complete(data / OP_COUNT, data % OP_COUNT, res);
+            }
+        }
+        return true;
+    }
+
+private:
+    enum op { OP_OPEN, OP_STAT, OP_READ, OP_COUNT };
+
+    struct slot {
+        std::size_t index;
+        int fd;
+        int open_res;
+        int stat_res;
+        /// Number of operations of openat and statx in flight.
+        int opening;
+        /// Size reported by statx, zero if unknown.
+        std::size_t expected;
+        std::size_t size;
+        struct statx stx;
+        std::string data;
+    };
+
+    io_uring_sqe *prepare(std::size_t s, op o, unsigned char opcode) {
+        io_uring_sqe *sqe = ring_.get_sqe();
+        // Every slot has at most two entries in flight and the ring
+        // holds two per slot.
+        sqe->opcode = opcode;
+        sqe->user_data = s * OP_COUNT + o;
+        return sqe;
+    }
+
+    void start(std::size_t s) {
+        slot &sl = slots_[s];
+        sl.index = next_++;
+        sl.fd = -1;
+        sl.opening = 2;
+        const char *path = paths_[sl.index].c_str();
+        io_uring_sqe *sqe = prepare(s, OP_OPEN, IORING_OP_OPENAT);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uintptr_t>(path);
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe = prepare(s, OP_STAT, IORING_OP_STATX);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uintptr_t>(path);
+        sqe->len = STATX_TYPE | STATX_SIZE;
+        sqe->off = reinterpret_cast<uintptr_t>(&sl.stx);
+        ++active_;
+    }
+
+    void read(std::size_t s) {
+        slot &sl = slots_[s];
+        io_uring_sqe *sqe = prepare(s, OP_READ, IORING_OP_READ);
+        sqe->fd = sl.fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(&sl.data[sl.size]);
+        sqe->len = sl.data.size() - sl.size;
+        sqe->off = sl.size;
+    }
+
+    void complete(std::size_t s, uint64_t o, int res) {
+        slot &sl = slots_[s];
+        switch (o) {
+        case OP_OPEN:
+            sl.open_res = res;
+            if (res >= 0)
+                sl.fd = res;
+            if (--sl.opening == 0)
+                opened(s);
+            break;
+        case OP_STAT:
+            sl.stat_res = res;
+            if (--sl.opening == 0)
+                opened(s);
+            break;
+        case OP_READ:
+            if (res < 0) {
+                finish(s, describe(paths_[sl.index], "read", -res));
+                break;
+            }
+            sl.size += res;
+            if (res == 0 || at_end(sl.expected, sl.size, sl.data.size())) {
+                sl.data.resize(sl.size);
+                finish(s, std::string());
+                break;
+            }
+            if (sl.size == sl.data.size())
+                sl.data.resize(2 * sl.size);
+            read(s);
+            break;
+        }
+    }
+
+    void opened(std::size_t s) {
+        slot &sl = slots_[s];
+        const std::string &path = paths_[sl.index];
+        if (sl.open_res < 0)
+            return finish(s, describe(path, "open", -sl.open_res));
+        if (sl.stat_res < 0)
+            return finish(s, describe(path, "stat", -sl.stat_res));
+        sl.expected = S_ISREG(sl.stx.stx_mode) ? sl.stx.stx_size : 0;
+        sl.size = 0;
+        sl.data.resize(sl.expected + 4096);
+        read(s);
+    }
+
+    /**
+     * Stops after a failure of the ring.  Operations in flight write into
+     * the slots, so their completions are awaited before the slots may
+     * be freed, and the files opened meanwhile are closed.
+     */
+    void abandon() {
+        std::string error;
+        bool drained = true;
+        while (drained && ring_.in_flight() > 0) {
+            while (io_uring_cqe *cqe = ring_.peek()) {
+                const uint64_t data = cqe->user_data;
+                const int res = cqe->res;
+                ring_.seen();
+                if (data % OP_COUNT == OP_OPEN && res >= 0)
+                    slots_[data / OP_COUNT].fd = res;
+            }
+            if (ring_.in_flight() > 0)
+                drained = ring_.wait(error);
+        }
+        for (std::size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].fd >= 0)
+                ::close(slots_[i].fd);
+            slots_[i].fd = -1;
+        }
+        if (!drained) {
+            // The kernel may still write into the slots, leak them rather
+            // than let it write into freed memory.
+            std::vector<slot> *leaked = new std::vector<slot>();
+            leaked->swap(slots_);
+        }
+    }
+
+    void finish(std::size_t s, const std::string &error) {
+        slot &sl = slots_[s];
+        if (sl.fd >= 0)
+            ::close(sl.fd);
+        sl.fd = -1;
+        out_.push(sl.index, sl.data, error);
+        sl.data.clear();
+        --active_;
+        if (next_ < paths_.size())
+            start(s);
+    }
+
+    const std::vector<std::string> &paths_;
+    delivery &out_;
+    uring &ring_;
+    std::vector<slot> slots_;
+    std::size_t next_;
+    std::size_t active_;
+};
+#endif
+
+/**
+ * Replays parsed files into documents.
+ */
+class document_filler : public bulk_loader::handler {
+public:
+    document_filler(const std::vector<document *> &docs,
+                    std::vector<std::string> &errors)
+        : docs_(docs)
+        , errors_(errors)
+    {}
+
+    void parse(std::size_t index, const std::string &path, parser &p) {
+        document &doc = *docs_[index];
+        parser::event e;
+        std::string name;
+        while (p.advance(e)) {
+            switch (e.type) {
+            case parser::EVENT_SECTION:
+                if (!doc.add_section(e.value))
+                    return fail(index, path, path + ": " + doc.error());
+                break;
+            case parser::EVENT_NAME:
+                name.swap(e.value);
+                break;
+            case parser::EVENT_VALUE:
+                if (!doc.add_param(name, e.value))
+                    return fail(index, path, path + ": " + doc.error());
+                break;
+            case parser::EVENT_INCLUDE:
+                return fail(index, path,
+                            path + ": include directives are not followed");
+            default:
+                break;
+            }
+        }
+        if (e.type == parser::EVENT_ERROR)
+            fail(index, path, e.value);
+    }
+
+    void fail(std::size_t index, const std::string &,
+              const std::string &error) {
+        errors_[index] = error;
+    }
+
+private:
+    const std::vector<document *> &docs_;
+    std::vector<std::string> &errors_;
+};
+}
+
+bulk_loader::bulk_loader(std::size_t workers, std::size_t queue_depth)
+    : workers_(workers)
+    , queue_depth_(queue_depth ? queue_depth : 1)
+    , engine_(ENGINE_AUTO)
+    , used_(ENGINE_AUTO)
+{}
+
+bool bulk_loader::io_uring_available() {
+#ifdef CONFIG_INI_HAS_IO_URING
+    uring ring;
+    std::string error;
+    return ring.init(2, error);
+#else
+    return false;
+#endif
+}
+
+bool bulk_loader::run(const std::vector<std::string> &paths, handler &h) {
+    error_.clear();
+    used_ = ENGINE_THREADS;
+#ifdef CONFIG_INI_HAS_IO_URING
+    uring ring;
+    if (engine_ != ENGINE_THREADS) {
+        const std::size_t depth = std::min(queue_depth_, paths.size());
+        if (ring.init(2 * (depth ? depth : 1), error_))
+            used_ = ENGINE_IO_URING;
+        else if (engine_ == ENGINE_IO_URING)
+            return false;
+    }
+#else
+    if (engine_ == ENGINE_IO_URING) {
+        error_ = "io_uring is not supported by this build";
+        return false;
+    }
+#endif
+    delivery out(paths, h, workers_, queue_depth_);
+    bool ok = true;
+#ifdef CONFIG_INI_HAS_IO_URING
+    if (used_ == ENGINE_IO_URING)
+        ok = uring_reader(paths, out, ring).run(queue_depth_, error_);
+#endif
+    if (used_ == ENGINE_THREADS)
+        reader_pool(paths, out).run(std::min(queue_depth_, paths.size()));
+    out.finish();
+    return ok;
+}
+
+bool bulk_loader::load(const std::vector<std::string> &paths,
+                       const std::vector<document *> &docs,
+                       std::vector<std::string> &errors) {
+    errors.assign(paths.size(), std::string());
+    document_filler filler(docs, errors);
+    if (!run(paths, filler))
+        return false;
+    for (std::size_t i = 0; i < errors.size(); ++i)
+        if (!errors[i].empty())
+            return false;
+    return true;
+}
+}
+}
@@ -0,0 +1,108 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_CHARS_HPP
+#define CONFIG_INI_CHARS_HPP
+
+/**
+ * @file
+ *
+ * @detail Character classes and message formatting shared by the
+ * parsers.
+ */
+
+#include <cctype>
+#include <cstddef>
+
+namespace config {
+namespace ini {
+namespace chars {
+
+// <cctype> functions are undefined for negative values other than EOF,
+// and bytes >= 0x80 are negative chars on most platforms.
+inline bool is_space(char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+inline bool has_bom(const char *p, const char *end) {
+    return end - p >= 3 && p[0] == '\xEF' && p[1] == '\xBB' &&
+           p[2] == '\xBF';
+}
+
+/**
+ * Returns the character denoted by the escape sequence "\c".
+ */
+inline char unescape(char c) {
+    switch (c) {
+    case 'n':
+        return '\n';
+    case 'r':
+        return '\r';
+    case 't':
+        return '\t';
+    case '0':
+        return '\0';
+    default:
+        return c;
+    }
+}
+
+/**
+ * Bounded writer of diagnostics, the output is truncated when the buffer
+ * is full.  Messages are composed without allocating, so that the
+ * fixed parser can report errors.
+ */
+class bounded_writer {
+public:
+    bounded_writer(char *buf, std::size_t size)
+        : buf_(buf)
+        , size_(size)
+        , n_(0)
+    {
+        buf_[0] = '\0';
+    }
+
+    bounded_writer &operator<<(const char *s) {
+        while (*s && n_ + 1 < size_)
+            buf_[n_++] = *s++;
+        buf_[n_] = '\0';
+        return *this;
+    }
+
+    bounded_writer &operator<<(std::size_t v) {
+        char digits[24];
+        std::size_t n = 0;
+        do {
+            digits[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        while (n && n_ + 1 < size_)
+            buf_[n_++] = digits[--n];
+        buf_[n_] = '\0';
+        return *this;
+    }
+
+    std::size_t size() const { return n_; }
+
+private:
+    char *buf_;
+    std::size_t size_;
+    std::size_t n_;
+};
+}
+}
+}
+
+#endif
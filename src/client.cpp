@@ -0,0 +1,310 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The client uses a blocking socket.  Requests of a lookup are
+ * pipelined, but the server stops reading a connection while too many of
+ * its responses are unsent.  Requests are therefore written without
+ * blocking, and whenever the socket is full the client reads the
+ * response to the oldest request in flight before writing more.
+ */
+
+#include "config/ini/client.hpp"
+#include "protocol.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace config {
+namespace ini {
+
+client::client(const std::string &socket_path)
+    : socket_path_(socket_path)
+    , fd_(-1)
+    , batch_size_(256)
+    , next_id_(0)
+    , generation_(0)
+{}
+
+client::~client() { disconnect(); }
+
+void client::set_batch_size(std::size_t size) {
+    batch_size_ = size ? size : 1;
+}
+
+void client::invalidate() { cache_.clear(); }
+
+bool client::connect() {
+    if (fd_ >= 0)
+        return true;
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path_.size() >= sizeof(addr.sun_path)) {
+        error_ = socket_path_ + ": socket path is too long";
+        return false;
+    }
+    std::memcpy(addr.sun_path, socket_path_.c_str(), socket_path_.size());
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0)
+        return fail("socket");
+    if (::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr),
+                  sizeof(addr)) != 0) {
+        const bool r = fail("connect");
+        disconnect();
+        return r;
+    }
+    return true;
+}
+
+void client::disconnect() {
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+}
+
+/**
+ * Writes \p frame from \p pos on, advancing \p pos.  If the socket is
+ * full, returns early when \p may_stop is set and waits otherwise.
+ */
+bool client::send(const std::string &frame, std::size_t &pos,
+                  bool may_stop) {
+    while (pos < frame.size()) {
+        const ssize_t n = ::send(fd_, frame.data() + pos, frame.size() - pos,
+                                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n >= 0) {
+            pos += n;
+            continue;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (may_stop)
+                return true;
+            struct pollfd p;
+            p.fd = fd_;
+            p.events = POLLOUT;
+            if (::poll(&p, 1, -1) >= 0 || errno == EINTR)
+                continue;
+        }
+        const bool r = fail("send");
+        disconnect();
+        return r;
+    }
+    return true;
+}
+
+bool client::receive(std::string &body) {
+    uint32_t size = 0;
+    std::size_t have = 0;
+    std::size_t need = sizeof(size);
+    char *dst = reinterpret_cast<char *>(&size);
+    for (int part = 0; part < 2; ++part) {
+        while (have < need) {
+            const ssize_t n = ::recv(fd_, dst + have, need - have, 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n == 0)
+                    errno = ECONNRESET;
+                const bool r = fail("recv");
+                disconnect();
+                return r;
+            }
+            have += n;
+        }
+        if (part == 0) {
+            if (size > protocol::max_frame) {
+                error_ = socket_path_ + ": response is too large";
+                disconnect();
+                return false;
+            }
+            body.resize(size);
+            dst = size ? &body[0] : 0;
+            have = 0;
+            need = size;
+        }
+    }
+    return true;
+}
+
+void client::check_generation(uint64_t generation) {
+    if (generation != generation_) {
+        cache_.clear();
+        generation_ = generation;
+    }
+}
+
+bool client::lookup(std::vector<query> &queries) {
+    error_.clear();
+    std::vector<std::size_t> missing;
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        query &q = queries[i];
+        const std::map<key, entry>::const_iterator it =
+            cache_.find(key(q.section, q.name));
+        if (it == cache_.end()) {
+            missing.push_back(i);
+        } else {
+            q.found = it->second.first;
+            q.value = it->second.second;
+        }
+    }
+    if (missing.empty())
+        return true;
+    if (!connect())
+        return false;
+
+    // Batches are answered in order, so the response to batch i has
+    // the id first_id + i.
+    const uint32_t first_id = next_id_;
+    std::size_t sent = 0, received = 0;
+    for (std::size_t b = 0; b < missing.size(); b += batch_size_) {
+        const std::size_t end = std::min(missing.size(), b + batch_size_);
+        std::string frame;
+        protocol::put(frame, uint32_t(0));
+        protocol::put(frame, next_id_++);
+        protocol::put(frame, uint8_t(protocol::OP_GET));
+        protocol::put(frame, static_cast<uint32_t>(end - b));
+        for (std::size_t i = b; i < end; ++i) {
+            protocol::put_str(frame, queries[missing[i]].section);
+            protocol::put_str(frame, queries[missing[i]].name);
+        }
+        const uint32_t size = frame.size() - sizeof(uint32_t);
+        std::memcpy(&frame[0], &size, sizeof(size));
+        std::size_t pos = 0;
+        for (;;) {
+            // The server may have stopped reading until its responses
+            // are read, so the socket being full is a cue to read one.
+            if (!send(frame, pos, received < sent))
+                return false;
+            if (pos == frame.size())
+                break;
+            if (!receive_batch(queries, missing, received, first_id))
+                return false;
+            ++received;
+        }
+        ++sent;
+    }
+    for (; received < sent; ++received)
+        if (!receive_batch(queries, missing, received, first_id))
+            return false;
+    return true;
+}
+
+/**
+ * Reads the response to the \p batch-th request of a lookup and fills
+ * the queries it answers.
+ */
+bool client::receive_batch(std::vector<query> &queries,
+                           const std::vector<std::size_t> &missing,
+                           std::size_t batch, uint32_t first_id) {
+    const std::size_t b = batch * batch_size_;
+    const std::size_t end = std::min(missing.size(), b + batch_size_);
+    std::string body;
+    if (!receive(body))
+        return false;
+    protocol::reader r(body.data(), body.size());
+    uint32_t response_id, count;
+    uint8_t status;
+    uint64_t generation;
+    if (!r.get(response_id) || !r.get(status) || !r.get(generation) ||
+        !r.get(count) || response_id != first_id + batch ||
+        status != protocol::STATUS_OK || count != end - b) {
+        error_ = socket_path_ + ": malformed response";
+        disconnect();
+        return false;
+    }
+    check_generation(generation);
+    for (std::size_t i = b; i < end; ++i) {
+        query &q = queries[missing[i]];
+        uint8_t found;
+        if (!r.get(found) || (found && !r.get_str(q.value))) {
+            error_ = socket_path_ + ": malformed response";
+            disconnect();
+            return false;
+        }
+        q.found = found;
+        if (!found)
+            q.value.clear();
+        cache_[key(q.section, q.name)] = entry(q.found, q.value);
+    }
+    return true;
+}
+
+bool client::get(const std::string &section, const std::string &name,
+                 std::string &value) {
+    std::vector<query> queries(1, query(section, name));
+    if (!lookup(queries) || !queries[0].found)
+        return false;
+    value.swap(queries[0].value);
+    return true;
+}
+
+bool client::list(const std::string &section,
+                  std::vector<std::string> &names) {
+    error_.clear();
+    names.clear();
+    if (!connect())
+        return false;
+    std::string frame;
+    protocol::put(frame, uint32_t(0));
+    const uint32_t id = next_id_++;
+    protocol::put(frame, id);
+    protocol::put(frame, uint8_t(protocol::OP_LIST));
+    protocol::put(frame, uint32_t(1));
+    protocol::put_str(frame, section);
+    const uint32_t size = frame.size() - sizeof(uint32_t);
+    std::memcpy(&frame[0], &size, sizeof(size));
+
+    std::string body;
+    std::size_t pos = 0;
+    if (!send(frame, pos, false) || !receive(body))
+        return false;
+    protocol::reader r(body.data(), body.size());
+    uint32_t response_id, count, n = 0;
+    uint8_t status, found;
+    uint64_t generation;
+    bool ok = r.get(response_id) && r.get(status) && r.get(generation) &&
+              r.get(count) && response_id == id &&
+              status == protocol::STATUS_OK && count == 1 && r.get(found) &&
+              (!found || r.get(n));
+    for (uint32_t i = 0; ok && i < n; ++i) {
+        names.push_back(std::string());
+        ok = r.get_str(names.back());
+    }
+    if (!ok) {
+        names.clear();
+        error_ = socket_path_ + ": malformed response";
+        disconnect();
+        return false;
+    }
+    check_generation(generation);
+    return true;
+}
+
+bool client::fail(const char *what) {
+    error_ = socket_path_ + ": " + what + ": " + std::strerror(errno);
+    return false;
+}
+}
+}
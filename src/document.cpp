@@ -0,0 +1,479 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail Names are hashed eight bytes at a time.  For case insensitive
+ * documents every word is lowercased with SWAR arithmetic before it is
+ * mixed in, so neither hashing nor lookups ever make lowercase copies of
+ * the names.  Only ASCII letters are folded; other bytes are compared
+ * as is.
+ */
+
+#include "config/ini/document.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace config {
+namespace ini {
+
+namespace {
+const uint64_t ones = 0x0101010101010101ull;
+const uint64_t high_bits = 0x8080808080808080ull;
+
+/**
+ * Lowercases ASCII letters in all eight bytes of the word.
+ */
+uint64_t fold_word(uint64_t w) {
+    const uint64_t low = w & ~high_bits;
+    // The high bit of a byte in ge_a (gt_z) is set if the byte is at
+    // least 'A' (greater than 'Z'); bytes >= 0x80 are excluded by ~w.
+    const uint64_t ge_a = low + (0x80 - 'A') * ones;
+    const uint64_t gt_z = low + (0x80 - 'Z' - 1) * ones;
+    const uint64_t upper = ge_a & ~gt_z & ~w & high_bits;
+    return w | (upper >> 2);
+}
+
+uint64_t mix(uint64_t h, uint64_t w) {
+    h ^= w;
+    h *= 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+char fold_char(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+uint64_t param_key_hash(std::size_t section, uint64_t name_hash) {
+    return mix(name_hash, section);
+}
+
+int compare(const char *lhs, std::size_t ln, const char *rhs, std::size_t rn,
+            bool fold) {
+    const std::size_t n = ln < rn ? ln : rn;
+    for (std::size_t i = 0; i < n; ++i) {
+        const unsigned char l = fold ? fold_char(lhs[i]) : lhs[i];
+        const unsigned char r = fold ? fold_char(rhs[i]) : rhs[i];
+        if (l != r)
+            return l < r ? -1 : 1;
+    }
+    return ln == rn ? 0 : (ln < rn ? -1 : 1);
+}
+}
+
+document::document(const options &opts, memory_resource *resource)
+    : options_(opts)
+    , sections_(resource)
+    , section_hashes_(resource)
+    , params_(resource)
+    , param_hashes_(resource)
+    , capacities_(resource)
+    , values_(resource)
+    , section_slots_(resource)
+    , param_slots_(resource)
+    , tree_(resource)
+    , current_(npos)
+    , skip_params_(false)
+{}
+
+bool document::add_section(const std::string &name) {
+    const uint64_t h = hash(name.data(), name.size());
+    std::size_t slot = section_slot(name, h);
+    skip_params_ = false;
+    if (slot != npos && section_slots_[slot]) {
+        current_ = section_slots_[slot] - 1;
+        switch (options_.duplicate_sections) {
+        case DUPLICATE_ERROR:
+            error_ = "duplicate section [" + name + "]";
+            return false;
+        case DUPLICATE_FIRST:
+            skip_params_ = true;
+            break;
+        case DUPLICATE_LAST:
+            drop_params(current_);
+            break;
+        case DUPLICATE_MERGE:
+            break;
+        }
+        return true;
+    }
+    current_ = sections_.size();
+    sections_.push_back(string(name.data(), name.size(), get_resource()));
+    section_hashes_.push_back(h);
+    add_path(sections_.back(), current_);
+    if (2 * sections_.size() > section_slots_.size()) {
+        rehash_sections();
+    } else {
+        section_slots_[slot] = sections_.size();
+    }
+    return true;
+}
+
+bool document::add_param(const std::string &name, const std::string &value) {
+    if (current_ == npos)
+        add_section("");
+    if (skip_params_)
+        return true;
+
+    // "name[]" appends to the list "name".
+    std::size_t n = name.size();
+    duplicate_policy policy = options_.duplicate_params;
+    if (n >= 2 && name[n - 2] == '[' && name[n - 1] == ']') {
+        n = name.find_last_not_of(" \t", n - 3) + 1;
+        policy = DUPLICATE_MERGE;
+    }
+
+    // Duplicates are detected by the same probe that finds the slot for
+    // a new parameter.
+    const char *key = name.data();
+    const uint64_t h = param_key_hash(current_, hash(key, n));
+    const std::size_t slot = param_slot(current_, key, n, h);
+    if (slot != npos && param_slots_[slot]) {
+        const std::size_t i = param_slots_[slot] - 1;
+        switch (policy) {
+        case DUPLICATE_ERROR: {
+            const string &section = sections_[current_];
+            error_ = "duplicate parameter '" + name.substr(0, n) +
+                     "' in section [";
+            error_.append(section.data(), section.size()).append("]");
+            return false;
+        }
+        case DUPLICATE_FIRST:
+            break;
+        case DUPLICATE_LAST: {
+            param &p = params_[i];
+            p.count = 1;
+            values_[p.first].assign(value.data(), value.size());
+            break;
+        }
+        case DUPLICATE_MERGE:
+            append_value(i, value);
+            break;
+        }
+        return true;
+    }
+
+    params_.push_back(
+        param(current_, key, n, values_.size(), 1, get_resource()));
+    param_hashes_.push_back(h);
+    capacities_.push_back(1);
+    values_.push_back(string(value.data(), value.size(), get_resource()));
+    if (2 * params_.size() > param_slots_.size()) {
+        rehash_params(param_slots_.empty() ? 16 : 2 * param_slots_.size());
+    } else {
+        param_slots_[slot] = params_.size();
+    }
+    return true;
+}
+
+const string *document::get(const std::string &section,
+                            const std::string &name) const {
+    const std::size_t i = find_param(section, name);
+    if (i == npos)
+        return 0;
+    const param &p = params_[i];
+    return &values_[p.first + p.count - 1];
+}
+
+document::value_range document::get_all(const std::string &section,
+                                        const std::string &name) const {
+    const std::size_t i = find_param(section, name);
+    if (i == npos) {
+        const value_range none = { 0, 0 };
+        return none;
+    }
+    return values(params_[i]);
+}
+
+document::value_range document::values(const param &p) const {
+    const value_range r = { &values_[p.first], p.count };
+    return r;
+}
+
+std::size_t document::find_section(const std::string &name) const {
+    const std::size_t slot = section_slot(name, hash(name.data(),
+                                                     name.size()));
+    if (slot == npos || !section_slots_[slot])
+        return npos;
+    return section_slots_[slot] - 1;
+}
+
+std::size_t document::subtree(const std::string &path,
+                             std::vector<std::size_t> &out) const {
+    if (tree_.empty())
+        return 0;
+    std::size_t node = 0;
+    for (std::size_t pos = 0; !path.empty();) {
+        const std::size_t dot = path.find('.', pos);
+        const std::size_t end = dot == std::string::npos ? path.size() : dot;
+        bool found;
+        const std::size_t i =
+            find_child(node, path.data() + pos, end - pos, found);
+        if (!found)
+            return 0;
+        node = tree_[node].children[i];
+        if (dot == std::string::npos)
+            break;
+        pos = dot + 1;
+    }
+
+    // Pre-order walk yields sections ordered by path.
+    const std::size_t size = out.size();
+    index_vector stack(1, node, get_resource());
+    while (!stack.empty()) {
+        const tree_node &n = tree_[stack.back()];
+        stack.pop_back();
+        if (n.section != npos)
+            out.push_back(n.section);
+        stack.insert(stack.end(), n.children.rbegin(), n.children.rend());
+    }
+    return out.size() - size;
+}
+
+void document::clear() {
+    tree_.clear();
+    sections_.clear();
+    section_hashes_.clear();
+    params_.clear();
+    param_hashes_.clear();
+    capacities_.clear();
+    values_.clear();
+    section_slots_.clear();
+    param_slots_.clear();
+    current_ = npos;
+    skip_params_ = false;
+    error_.clear();
+}
+
+void document::swap(document &other) {
+    std::swap(options_, other.options_);
+    sections_.swap(other.sections_);
+    section_hashes_.swap(other.section_hashes_);
+    params_.swap(other.params_);
+    param_hashes_.swap(other.param_hashes_);
+    capacities_.swap(other.capacities_);
+    values_.swap(other.values_);
+    section_slots_.swap(other.section_slots_);
+    param_slots_.swap(other.param_slots_);
+    tree_.swap(other.tree_);
+    std::swap(current_, other.current_);
+    std::swap(skip_params_, other.skip_params_);
+    error_.swap(other.error_);
+}
+
+uint64_t document::hash(const char *p, std::size_t n) const {
+    uint64_t h = n;
+    for (std::size_t i = 0; i < n; i += 8) {
+        uint64_t w = 0;
+        std::memcpy(&w, p + i, n - i < 8 ? n - i : 8);
+        h = mix(h, options_.case_insensitive ? fold_word(w) : w);
+    }
+    return h;
+}
+
+bool document::equal(const string &lhs, const char *rhs,
+                     std::size_t n) const {
+    if (lhs.size() != n)
+        return false;
+    if (!options_.case_insensitive)
+        return lhs.compare(0, n, rhs, n) == 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (fold_char(lhs[i]) != fold_char(rhs[i]))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Returns the slot holding the section \p name or the free slot where it
+ * belongs, npos if the table is empty.
+ */
+std::size_t document::section_slot(const std::string &name,
+                                   uint64_t h) const {
+    if (section_slots_.empty())
+        return npos;
+    const std::size_t mask = section_slots_.size() - 1;
+    for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+        const std::size_t s = section_slots_[i];
+        if (!s)
+            return i;
+        if (section_hashes_[s - 1] == h &&
+            equal(sections_[s - 1], name.data(), name.size()))
+            return i;
+    }
+}
+
+std::size_t document::find_param(const std::string &section,
+                                 const std::string &name) const {
+    const std::size_t s = find_section(section);
+    if (s == npos)
+        return npos;
+    const uint64_t h = param_key_hash(s, hash(name.data(), name.size()));
+    const std::size_t slot = param_slot(s, name.data(), name.size(), h);
+    if (slot == npos || !param_slots_[slot])
+        return npos;
+    return param_slots_[slot] - 1;
+}
+
+/**
+ * Appends value to the list of the parameter \p i.  A list that cannot
+ * grow in place is moved to the end of the value array with doubled
+ * capacity, so appends are amortized constant time and values of every
+ * parameter stay contiguous.
+ */
+void document::append_value(std::size_t i, const std::string &value) {
+    param &p = params_[i];
+    std::size_t &capacity = capacities_[i];
+    if (p.count == capacity) {
+        if (p.first + capacity == values_.size()) {
+            // The list is the last one in the array, it grows in place.
+            values_.push_back(string(value.data(), value.size(),
+                                     get_resource()));
+            ++capacity;
+            ++p.count;
+            return;
+        }
+        const std::size_t first = values_.size();
+        values_.resize(first + 2 * capacity, string(get_resource()));
+        for (std::size_t j = 0; j < p.count; ++j)
+            values_[first + j].swap(values_[p.first + j]);
+        p.first = first;
+        capacity *= 2;
+    }
+    values_[p.first + p.count].assign(value.data(), value.size());
+    ++p.count;
+}
+
+/**
+ * Removes parameters of the section \p section.  Their values are left in
+ * the value array unreferenced.
+ */
+void document::drop_params(std::size_t section) {
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < params_.size(); ++i) {
+        if (params_[i].section == section)
+            continue;
+        if (out != i) {
+            params_[out] = params_[i];
+            param_hashes_[out] = param_hashes_[i];
+            capacities_[out] = capacities_[i];
+        }
+        ++out;
+    }
+    params_.erase(params_.begin() + out, params_.end());
+    param_hashes_.resize(out);
+    capacities_.resize(out);
+    rehash_params(param_slots_.size());
+}
+
+std::size_t document::param_slot(std::size_t section, const char *name,
+                                 std::size_t n, uint64_t h) const {
+    if (param_slots_.empty())
+        return npos;
+    const std::size_t mask = param_slots_.size() - 1;
+    for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+        const std::size_t p = param_slots_[i];
+        if (!p)
+            return i;
+        const param &candidate = params_[p - 1];
+        if (param_hashes_[p - 1] == h && candidate.section == section &&
+            equal(candidate.name, name, n))
+            return i;
+    }
+}
+
+void document::rehash_sections() {
+    index_vector slots(section_slots_.empty() ? 16
+                                              : 2 * section_slots_.size(),
+                       0, get_resource());
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t s = 0; s < sections_.size(); ++s) {
+        std::size_t i = section_hashes_[s] & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = s + 1;
+    }
+    section_slots_.swap(slots);
+}
+
+void document::rehash_params(std::size_t size) {
+    index_vector slots(size, 0, get_resource());
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t p = 0; p < params_.size(); ++p) {
+        std::size_t i = param_hashes_[p] & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = p + 1;
+    }
+    param_slots_.swap(slots);
+}
+
+void document::add_path(const string &name, std::size_t section) {
+    if (tree_.empty()) {
+        tree_.push_back(tree_node(npos, 0, 0, get_resource()));
+    }
+    std::size_t node = 0;
+    for (std::size_t pos = 0; !name.empty();) {
+        const std::size_t dot = name.find('.', pos);
+        const std::size_t end = dot == string::npos ? name.size() : dot;
+        bool found;
+        const std::size_t i =
+            find_child(node, name.data() + pos, end - pos, found);
+        if (found) {
+            node = tree_[node].children[i];
+        } else {
+            tree_.push_back(tree_node(section, pos, end - pos,
+                                      get_resource()));
+            index_vector &children = tree_[node].children;
+            children.insert(children.begin() + i, tree_.size() - 1);
+            node = tree_.size() - 1;
+        }
+        if (dot == std::string::npos)
+            break;
+        pos = dot + 1;
+    }
+    tree_[node].section = section;
+}
+
+/**
+ * Returns position of the child \p name of the trie node \p node in its
+ * ordered list of children, or the position where it belongs.
+ */
+std::size_t document::find_child(std::size_t node, const char *name,
+                                 std::size_t size, bool &found) const {
+    const index_vector &children = tree_[node].children;
+    std::size_t lo = 0;
+    std::size_t hi = children.size();
+    found = false;
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        const tree_node &c = tree_[children[mid]];
+        const int r = compare(sections_[c.section_name].data() + c.offset,
+                              c.size, name, size, options_.case_insensitive);
+        if (r == 0) {
+            found = true;
+            return mid;
+        }
+        if (r < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+}
+}
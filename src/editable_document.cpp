@@ -0,0 +1,280 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The document is built from parser events: every event carries
+ * the byte range of its token, and the gaps between consecutive tokens
+ * are recorded as layout and comment segments.  Nothing is ever
+ * re-serialized: saving walks the list of pending patches in offset
+ * order and copies the original text between them as is.
+ */
+
+#include "config/ini/editable_document.hpp"
+#include "config/ini/parser.hpp"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace config {
+namespace ini {
+
+namespace {
+struct patch {
+    std::size_t offset;
+    std::size_t length;
+    const std::string *text;
+    bool insert;
+};
+
+bool patch_less(const patch &lhs, const patch &rhs) {
+    return lhs.offset < rhs.offset;
+}
+
+/**
+ * Returns source form of the value, quoting it if it would not survive
+ * parsing as is.
+ */
+std::string format_value(const std::string &value) {
+    const std::size_t n = value.size();
+    if (value.find_first_of(";\"'\r\n") == std::string::npos &&
+        (n == 0 || (!std::isspace(static_cast<unsigned char>(value[0])) &&
+                    !std::isspace(static_cast<unsigned char>(value[n - 1])) &&
+                    value[n - 1] != '\\'))) {
+        return value;
+    }
+    std::string quoted("\"");
+    for (std::size_t i = 0; i < n; ++i) {
+        switch (value[i]) {
+        case '\r':
+            quoted.append("\\r");
+            break;
+        case '\n':
+            quoted.append("\\n");
+            break;
+        case '"':
+            quoted.append("\\\"");
+            break;
+        case '\\':
+            quoted.append("\\\\");
+            break;
+        default:
+            quoted.push_back(value[i]);
+        }
+    }
+    quoted.push_back('"');
+    return quoted;
+}
+
+void append_param(std::string &out, const std::string &name,
+                  const std::string &value) {
+    out.append(name);
+    out.append(" = ");
+    out.append(format_value(value));
+    out.push_back('\n');
+}
+}
+
+editable_document::editable_document() {}
+
+bool editable_document::load(std::istream &in, const std::string &filename) {
+    std::ostringstream content;
+    content << in.rdbuf();
+    text_ = content.str();
+    error_.clear();
+    segments_.clear();
+    params_.clear();
+    section_ends_.clear();
+    added_.clear();
+    edits_.clear();
+
+    std::istringstream is(text_);
+    parser p(filename, is);
+    parser::event e;
+    std::string section;
+    std::string name;
+    std::size_t pos = 0;
+
+    while (p.advance(e)) {
+        add_layout(pos, e.offset);
+        pos = e.offset + e.length;
+        switch (e.type) {
+        case parser::EVENT_SECTION:
+            add_segment(segment::SECTION, e.offset, e.length);
+            section = e.value;
+            section_ends_[section] = line_end(pos);
+            break;
+        case parser::EVENT_NAME:
+            add_segment(segment::NAME, e.offset, e.length);
+            name = e.value;
+            break;
+        case parser::EVENT_VALUE: {
+            add_segment(segment::VALUE, e.offset, e.length);
+            param &prm = params_[key(section, name)];
+            prm.value_segment = segments_.size() - 1;
+            prm.value = e.value;
+            section_ends_[section] = line_end(pos);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    if (e.type == parser::EVENT_ERROR) {
+        error_ = e.value;
+        return false;
+    }
+    add_layout(pos, text_.size());
+    return true;
+}
+
+const std::string *editable_document::get(const std::string &section,
+                                           const std::string &name) const {
+    const std::map<key, param>::const_iterator it =
+        params_.find(key(section, name));
+    return it == params_.end() ? 0 : &it->second.value;
+}
+
+void editable_document::set(const std::string &section,
+                            const std::string &name,
+                            const std::string &value) {
+    const key k(section, name);
+    std::map<key, param>::iterator it = params_.find(k);
+    if (it == params_.end()) {
+        param p;
+        p.value_segment = npos;
+        p.value = value;
+        params_.insert(std::make_pair(k, p));
+        added_.push_back(k);
+        return;
+    }
+    it->second.value = value;
+    it->second.text = format_value(value);
+    if (it->second.value_segment != npos) {
+        const segment &s = segments_[it->second.value_segment];
+        edits_[s.offset] = &it->second;
+    }
+}
+
+void editable_document::save(std::ostream &os) const {
+    std::vector<patch> patches;
+    patches.reserve(edits_.size() + added_.size());
+
+    for (std::map<std::size_t, const param *>::const_iterator it =
+             edits_.begin();
+         it != edits_.end(); ++it) {
+        const segment &s = segments_[it->second->value_segment];
+        patch pt = { s.offset, s.length, &it->second->text, false };
+        patches.push_back(pt);
+    }
+
+    // Parameters added to existing sections go right after the last line
+    // of the section, new sections are appended to the end of the text.
+    std::map<std::string, std::string> tails;
+    std::vector<std::string> new_sections;
+    for (std::vector<key>::const_iterator it = added_.begin();
+         it != added_.end(); ++it) {
+        std::map<std::string, std::string>::iterator t = tails.find(it->first);
+        if (t == tails.end()) {
+            t = tails.insert(std::make_pair(it->first, std::string())).first;
+            const bool known =
+                section_ends_.find(it->first) != section_ends_.end();
+            if (!known && it->first.empty()) {
+                // Parameters without section must precede the first one.
+                patch pt = { 0, 0, &t->second, true };
+                patches.push_back(pt);
+            } else if (!known) {
+                new_sections.push_back(it->first);
+                t->second.append("[").append(it->first).append("]\n");
+            }
+        }
+        append_param(t->second, it->second, params_.find(*it)->second.value);
+    }
+
+    for (std::map<std::string, std::size_t>::const_iterator it =
+             section_ends_.begin();
+         it != section_ends_.end(); ++it) {
+        std::map<std::string, std::string>::const_iterator t =
+            tails.find(it->first);
+        if (t == tails.end())
+            continue;
+        patch pt = { it->second, 0, &t->second, true };
+        patches.push_back(pt);
+    }
+    for (std::size_t i = 0; i < new_sections.size(); ++i) {
+        patch pt = { text_.size(), 0, &tails.find(new_sections[i])->second,
+                     true };
+        patches.push_back(pt);
+    }
+
+    // Value replacements were added first, so at equal offsets they are
+    // written before insertions.
+    std::stable_sort(patches.begin(), patches.end(), patch_less);
+
+    bool needs_lf = !text_.empty() && text_[text_.size() - 1] != '\n';
+    std::size_t pos = 0;
+    for (std::vector<patch>::const_iterator it = patches.begin();
+         it != patches.end(); ++it) {
+        os.write(text_.data() + pos, it->offset - pos);
+        if (it->insert && it->offset == text_.size() && needs_lf) {
+            // The last line has no line break yet.
+            os.put('\n');
+            needs_lf = false;
+        }
+        os.write(it->text->data(), it->text->size());
+        pos = it->offset + it->length;
+    }
+    os.write(text_.data() + pos, text_.size() - pos);
+}
+
+std::string editable_document::str() const {
+    std::ostringstream os;
+    save(os);
+    return os.str();
+}
+
+void editable_document::add_layout(std::size_t from, std::size_t to) {
+    while (from < to) {
+        const std::size_t comment = text_.find(';', from);
+        if (comment >= to) {
+            add_segment(segment::LAYOUT, from, to - from);
+            return;
+        }
+        add_segment(segment::LAYOUT, from, comment - from);
+        std::size_t end = text_.find_first_of("\r\n", comment);
+        if (end > to)
+            end = to;
+        add_segment(segment::COMMENT, comment, end - comment);
+        from = end;
+    }
+}
+
+void editable_document::add_segment(segment::kind type, std::size_t offset,
+                                    std::size_t length) {
+    if (length == 0 && type != segment::VALUE)
+        return;
+    segment s = { type, offset, length };
+    segments_.push_back(s);
+}
+
+std::size_t editable_document::line_end(std::size_t offset) const {
+    const std::size_t lf = text_.find('\n', offset);
+    return lf == std::string::npos ? text_.size() : lf + 1;
+}
+}
+}
@@ -0,0 +1,70 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The state functions are those of parser_machine, which is
+ * instantiated with view_tokens next to its implementation.
+ */
+
+#include "config/ini/fixed_parser.hpp"
+#include "chars.hpp"
+#include <algorithm>
+
+namespace config {
+namespace ini {
+
+const std::size_t view_tokens::max_diagnostic;
+
+void view_tokens::error(event &e, std::size_t line, std::size_t column,
+                        const char *message) {
+    chars::bounded_writer w(diagnostic_, max_diagnostic);
+    w << filename_ << ":" << line << ":" << column << ": " << message;
+    e.data = diagnostic_;
+    e.size = w.size();
+}
+
+#if __cplusplus >= 201103L
+void view_tokens::swap(view_tokens &other) {
+    std::swap(scratch_, other.scratch_);
+    std::swap(scratch_size_, other.scratch_size_);
+    std::swap(filename_, other.filename_);
+    std::swap(owned_, other.owned_);
+    std::swap(overflow_, other.overflow_);
+    std::swap(held_data_, other.held_data_);
+    std::swap(held_size_, other.held_size_);
+    std::swap(held_owned_, other.held_owned_);
+    std::swap(diagnostic_, other.diagnostic_);
+}
+#endif
+
+template <typename Dialect>
+basic_fixed_parser<Dialect>::basic_fixed_parser(const char *data,
+                                                std::size_t size,
+                                                char *scratch,
+                                                std::size_t scratch_size,
+                                                const char *filename)
+    : machine(data, size, view_tokens(scratch, scratch_size, filename))
+{}
+
+template <typename Dialect>
+const std::size_t basic_fixed_parser<Dialect>::max_diagnostic;
+
+template class basic_fixed_parser<default_dialect>;
+template class basic_fixed_parser<relaxed_dialect>;
+}
+}
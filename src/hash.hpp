@@ -0,0 +1,67 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_HASH_HPP
+#define CONFIG_INI_HASH_HPP
+
+/**
+ * @file
+ *
+ * @detail Hashing of (section, parameter) keys shared by the flat lookup
+ * tables.  The hash of a key is independent of the process, so it may be
+ * stored in shared memory.
+ */
+
+#include <stdint.h>
+#include <string>
+
+namespace config {
+namespace ini {
+namespace hash {
+
+inline char fold_char(char c, bool fold) {
+    return fold && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+/**
+ * FNV-1a over the section name, a separator and the parameter name.
+ */
+template <typename Section, typename Name>
+uint32_t key_hash(const Section &section, const Name &name, bool fold) {
+    uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < section.size(); ++i)
+        h = (h ^ static_cast<unsigned char>(fold_char(section[i], fold))) *
+            16777619u;
+    h = (h ^ 0xff) * 16777619u;
+    for (std::size_t i = 0; i < name.size(); ++i)
+        h = (h ^ static_cast<unsigned char>(fold_char(name[i], fold))) *
+            16777619u;
+    return h;
+}
+
+template <typename String>
+bool equal(const char *lhs, std::size_t size, const String &rhs, bool fold) {
+    if (size != rhs.size())
+        return false;
+    for (std::size_t i = 0; i < size; ++i)
+        if (fold_char(lhs[i], fold) != fold_char(rhs[i], fold))
+            return false;
+    return true;
+}
+}
+}
+}
+
+#endif
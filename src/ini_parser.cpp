@@ -21,95 +21,598 @@
  * state is represented as member function pointer. When client calls
  * the advance() function the parser produces an event and switches
  * it's parse function to handle next expected event.
+ *
+ * The machine is shared by basic_parser, basic_fixed_parser and
+ * basic_resource_parser, which differ only in how tokens are stored, so
+ * it is instantiated here for every token storage.
  */
 
 #include "config/ini/parser.hpp"
+#include "config/ini/fixed_parser.hpp"
+#include "config/ini/resource_parser.hpp"
+#include "chars.hpp"
+#include <istream>
 #include <sstream>
-#include <cctype>
+#include <cstring>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef CONFIG_INI_PARSER_STATS
+#include <time.h>
+#define CONFIG_INI_STAT(expr) (expr)
+#define CONFIG_INI_STAT_SCOPE(s) state_scope stat_scope_(*this, stats::s)
+#else
+#define CONFIG_INI_STAT(expr) ((void)0)
+#define CONFIG_INI_STAT_SCOPE(s) ((void)0)
+#endif
 
 namespace config {
 namespace ini {
 
 namespace {
-const char *event_type_to_string(parser::event_type t) {
+const char *event_type_to_string(parser_base::event_type t) {
     switch (t) {
-    case parser::EVENT_ERROR:
+    case parser_base::EVENT_ERROR:
         return "ERROR";
-    case parser::EVENT_SECTION:
+    case parser_base::EVENT_SECTION:
         return "SECTION";
-    case parser::EVENT_NAME:
+    case parser_base::EVENT_NAME:
         return "NAME";
-    case parser::EVENT_VALUE:
+    case parser_base::EVENT_VALUE:
         return "VALUE";
-    case parser::EVENT_END:
+    case parser_base::EVENT_VALUE_PART:
+        return "VALUE_PART";
+    case parser_base::EVENT_INCLUDE:
+        return "INCLUDE";
+    case parser_base::EVENT_END:
         return "END";
     default:
         return "UNKNOWN";
     }
 }
 
-void trim_right(std::string &s) {
-    const std::size_t n = s.length();
-    std::size_t i = n;
-    while (i && std::isspace(s[i - 1]))
-        --i;
-    if (i != n) {
-        s.erase(i);
+#ifdef CONFIG_INI_PARSER_STATS
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+const std::size_t buffer_size = 64 * 1024;
+const std::size_t npos = static_cast<std::size_t>(-1);
+
+using chars::is_space;
+using chars::has_bom;
+using chars::unescape;
+
+/**
+ * Validates UTF-8 in the range [p, end) continuing from state \p st.
+ * Returns pointer to the first byte that makes the input invalid or end
+ * if the whole range is valid.
+ */
+const char *validate_utf8(const char *p, const char *end,
+                          parser_base::utf8_state &st) {
+    for (;;) {
+        if (st.need == 0) {
+#ifdef __SSE2__
+            // ASCII fast path: skip 16 bytes at a time.
+            while (end - p >= 16 &&
+                   !_mm_movemask_epi8(_mm_loadu_si128(
+                       reinterpret_cast<const __m128i *>(p))))
+                p += 16;
+#endif
+            while (p != end && !(*p & 0x80))
+                ++p;
+        }
+        if (p == end)
+            return end;
+
+        const unsigned char b = *p;
+        if (st.need) {
+            if (b < st.lo || b > st.hi)
+                return p;
+            st.lo = 0x80;
+            st.hi = 0xBF;
+            --st.need;
+            ++p;
+            continue;
+        }
+
+        st.lo = 0x80;
+        st.hi = 0xBF;
+        if (b >= 0xC2 && b <= 0xDF) {
+            st.need = 1;
+        } else if (b >= 0xE0 && b <= 0xEF) {
+            st.need = 2;
+            // Reject overlong forms and UTF-16 surrogates.
+            if (b == 0xE0)
+                st.lo = 0xA0;
+            else if (b == 0xED)
+                st.hi = 0x9F;
+        } else if (b >= 0xF0 && b <= 0xF4) {
+            st.need = 3;
+            // Reject overlong forms and code points above U+10FFFF.
+            if (b == 0xF0)
+                st.lo = 0x90;
+            else if (b == 0xF4)
+                st.hi = 0x8F;
+        } else {
+            return p;
+        }
+        ++p;
+    }
+}
+
+/**
+ * Returns pointer to the first quote, backslash or line break in the
+ * range [p, end), or end if there is none.
+ */
+const char *find_quoted_special(const char *p, const char *end, char quote) {
+#ifdef __SSE2__
+    const __m128i q = _mm_set1_epi8(quote);
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i m =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, q),
+                                      _mm_cmpeq_epi8(v, bs)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, lf),
+                                      _mm_cmpeq_epi8(v, cr)));
+        const int mask = _mm_movemask_epi8(m);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p != end && *p != quote && *p != '\\' && *p != '\n' && *p != '\r')
+        ++p;
+    return p;
+}
+
+/**
+ * Counts line breaks in the range [p, end): "\n", "\r\n" and a lone
+ * "\r" count once.  Bytes up to \p limit may be looked at to tell a lone
+ * carriage return from "\r\n"; \p cr is set if the range ends with a
+ * carriage return that cannot be told apart.  \p line_start is set to the
+ * byte following the last counted break, if any.
+ */
+std::size_t count_line_breaks(const char *p, const char *end,
+                              const char *limit, const char *&line_start,
+                              bool &cr) {
+    std::size_t n = 0;
+    cr = false;
+#ifdef __SSE2__
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i crs = _mm_set1_epi8('\r');
+    // The byte following each block must be available.
+    while (end - p > 16) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const unsigned lfs = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+        const unsigned crm = _mm_movemask_epi8(_mm_cmpeq_epi8(v, crs));
+        if (lfs | crm) {
+            const unsigned next_lf = (lfs >> 1) | ((p[16] == '\n') << 15);
+            const unsigned breaks = lfs | (crm & ~next_lf);
+            n += __builtin_popcount(breaks);
+            if (breaks)
+                line_start = p + 32 - __builtin_clz(breaks);
+        }
+        p += 16;
     }
+#endif
+    for (; p != end; ++p) {
+        if (*p == '\n') {
+            ++n;
+            line_start = p + 1;
+        } else if (*p == '\r') {
+            if (p + 1 == limit) {
+                cr = true;
+            } else if (p[1] != '\n') {
+                ++n;
+                line_start = p + 1;
+            }
+        }
+    }
+    return n;
+}
 }
+
+#ifdef CONFIG_INI_PARSER_STATS
+const bool parser_base::stats::enabled = true;
+
+/**
+ * Charges time elapsed since the last state switch to the active state
+ * function, so nested state functions are not counted twice.
+ */
+template <typename Dialect, typename Tokens>
+class parser_machine<Dialect, Tokens>::state_scope {
+public:
+    state_scope(parser_machine &p, stats::state_kind s)
+        : p_(p)
+        , prev_(p.stat_state_)
+    {
+        switch_to(s);
+    }
+
+    ~state_scope() { switch_to(prev_); }
+
+private:
+    void switch_to(stats::state_kind s) {
+        const uint64_t now = now_ns();
+        p_.stats_.state_ns[p_.stat_state_] += now - p_.stat_mark_;
+        p_.stat_mark_ = now;
+        p_.stat_state_ = s;
+    }
+
+    parser_machine &p_;
+    stats::state_kind prev_;
+};
+#else
+const bool parser_base::stats::enabled = false;
+#endif
+
+void string_tokens::error(event &e, std::size_t line, std::size_t column,
+                          const char *message) const {
+    std::ostringstream ss;
+    ss << filename_ << ":" << line << ":" << column << ": " << message;
+    e.value = ss.str();
 }
 
-parser::parser(const std::string &filename, std::istream &is)
-    : in_(is)
-    , filename_(filename)
-    , state_(&parser::advance_gen)
-    , line_(1)
-    , column_(1)
+template <typename Dialect, typename Tokens>
+parser_machine<Dialect, Tokens>::parser_machine(std::istream *in,
+                                                const Tokens &tokens)
+    : tokens_(tokens)
+    , in_(in)
+    , block_(0)
+    , block_size_(0)
+{
+    reset_settings();
+    reset_state();
+}
+
+template <typename Dialect, typename Tokens>
+parser_machine<Dialect, Tokens>::parser_machine(const char *data,
+                                                std::size_t size,
+                                                const Tokens &tokens)
+    : tokens_(tokens)
+    , in_(0)
+    , block_(data)
+    , block_size_(size)
+{
+    reset_settings();
+    reset_state();
+}
+
+#if __cplusplus >= 201103L
+template <typename Dialect, typename Tokens>
+parser_machine<Dialect, Tokens>::parser_machine(parser_machine &&other)
+    : tokens_(other.tokens_)
+    , in_(0)
+    , block_(0)
+    , block_size_(0)
+{
+    reset_settings();
+    reset_state();
+    *this = std::move(other);
+}
+
+template <typename Dialect, typename Tokens>
+parser_machine<Dialect, Tokens> &
+parser_machine<Dialect, Tokens>::operator=(parser_machine &&other) {
+    if (this == &other)
+        return *this;
+    // Moving the vector keeps its storage, so the buffer pointers stay
+    // valid.
+    tokens_.swap(other.tokens_);
+    in_ = other.in_;
+    block_ = other.block_;
+    block_size_ = other.block_size_;
+    state_ = other.state_;
+    line_base_ = other.line_base_;
+    line_start_ = other.line_start_;
+    pending_cr_ = other.pending_cr_;
+    buf_.swap(other.buf_);
+    begin_ = other.begin_;
+    cur_ = other.cur_;
+    end_ = other.end_;
+    base_ = other.base_;
+    eof_ = other.eof_;
+    validate_utf8_ = other.validate_utf8_;
+    utf8_ = other.utf8_;
+    utf8_error_ = other.utf8_error_;
+    chunk_size_ = other.chunk_size_;
+    limits_ = other.limits_;
+    exceeded_ = other.exceeded_;
+    entries_ = other.entries_;
+    read_ = other.read_;
+    cut_ = other.cut_;
+    stopped_ = other.stopped_;
+    value_offset_ = other.value_offset_;
+    value_folded_ = other.value_folded_;
+    value_emitted_ = other.value_emitted_;
+    quote_ = other.quote_;
+    stats_ = other.stats_;
+    stat_state_ = other.stat_state_;
+    stat_mark_ = other.stat_mark_;
+    other.in_ = 0;
+    other.block_ = 0;
+    other.block_size_ = 0;
+    other.reset_state();
+    return *this;
+}
+#endif
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::restart(std::istream *in) {
+    in_ = in;
+    reset_state();
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::reset_state() {
+    state_ = &parser_machine::advance_gen;
+    line_base_ = 1;
+    line_start_ = 0;
+    pending_cr_ = false;
+    // The buffer keeps its storage across resets and is only allocated
+    // once there is a stream.
+    if (buf_.empty() && in_)
+        buf_.resize(buffer_size);
+    begin_ = cur_ = end_ = in_ ? &buf_[0] : block_;
+    base_ = 0;
+    eof_ = false;
+    utf8_.need = 0;
+    utf8_error_ = npos;
+    tokens_.reset();
+    exceeded_ = limits::LIMIT_NONE;
+    entries_ = 0;
+    read_ = 0;
+    cut_ = false;
+    stopped_ = false;
+    std::memset(&stats_, 0, sizeof(stats_));
+    stat_state_ = stats::STATE_GEN;
+    stat_mark_ = 0;
+}
+
+template <typename Dialect>
+basic_parser<Dialect>::basic_parser()
+    : machine(0, string_tokens())
 {}
 
-parser::parser(std::istream & is)
-    : in_(is)
-    , filename_("(Unknown)")
-    , state_(&parser::advance_gen)
-    , line_(1)
-    , column_(1)
+template <typename Dialect>
+basic_parser<Dialect>::basic_parser(const std::string &filename,
+                                    std::istream &is)
+    : machine(&is, string_tokens(filename))
 {}
 
-bool parser::advance(event &e) { return (this->*state_)(e); }
+template <typename Dialect>
+basic_parser<Dialect>::basic_parser(std::istream &is)
+    : machine(&is, string_tokens("(Unknown)"))
+{}
 
-char parser::get_char() {
-    ++column_;
-    return in_.get();
+#if __cplusplus >= 201103L
+template <typename Dialect>
+basic_parser<Dialect>::basic_parser(basic_parser &&other)
+    : machine(std::move(other))
+{}
+
+template <typename Dialect>
+basic_parser<Dialect> &
+basic_parser<Dialect>::operator=(basic_parser &&other) {
+    machine::operator=(std::move(other));
+    return *this;
+}
+#endif
+
+template <typename Dialect>
+void basic_parser<Dialect>::reset(std::istream &in,
+                                  const std::string &filename) {
+    this->tokens_.set_filename(filename);
+    machine::restart(&in);
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance(event &e) {
+#ifdef CONFIG_INI_PARSER_STATS
+    stat_mark_ = now_ns();
+#endif
+    bool ok = (this->*state_)(e);
+    if (ok && tokens_.overflow()) {
+        state_ = &parser_machine::advance_eof;
+        unexpected_token(e, "token longer than the scratch buffer");
+        ok = false;
+    }
+#ifdef CONFIG_INI_PARSER_STATS
+    stats_.state_ns[stat_state_] += now_ns() - stat_mark_;
+    if (ok || e.type == EVENT_ERROR || e.type == EVENT_END)
+        ++stats_.events[e.type];
+    stats_.bytes = position();
+#endif
+    return ok;
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::set_validate_utf8(bool validate) {
+    validate_utf8_ = validate;
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::set_value_chunk_size(std::size_t size) {
+    chunk_size_ = size;
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::set_limits(const limits &l) {
+    limits_ = l;
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::reset_settings() {
+    validate_utf8_ = false;
+    chunk_size_ = 0;
+    limits_ = limits();
 }
 
-void parser::put_back(char c) {
-    --column_;
-    in_.putback(c);
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::set_origin(std::size_t offset,
+                                                 std::size_t line) {
+    base_ = offset;
+    line_base_ = line;
+    line_start_ = offset;
 }
 
-bool parser::advance_gen(event &e) {
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::locate(const char *p,
+                                             std::size_t &line,
+                                             std::size_t &column) const {
+    const char *start = 0;
+    bool cr;
+    line = line_base_ + count_line_breaks(begin_, p, end_, start, cr);
+    // A carriage return at the end of the buffer has been consumed as a
+    // line break already.
+    if (cr) {
+        ++line;
+        start = p;
+    }
+    const std::size_t line_start = start ? base_ + (start - begin_)
+                                         : line_start_;
+    column = base_ + (p - begin_) - line_start + 1;
+}
+
+template <typename Dialect, typename Tokens>
+std::size_t parser_machine<Dialect, Tokens>::line() const {
+    std::size_t line, column;
+    locate(cur_, line, column);
+    return line;
+}
+
+template <typename Dialect, typename Tokens>
+std::size_t parser_machine<Dialect, Tokens>::column() const {
+    std::size_t line, column;
+    locate(cur_, line, column);
+    return column;
+}
+
+template <typename Dialect, typename Tokens>
+const parser_base::stats &parser_machine<Dialect, Tokens>::statistics() const {
+    return stats_;
+}
+
+template <typename Dialect, typename Tokens>
+char parser_machine<Dialect, Tokens>::get_char() {
+    if (cur_ == end_ && !fill())
+        return '\0';
+    return *cur_++;
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::put_back() {
+    CONFIG_INI_STAT(++stats_.put_backs);
+    // Only the character just read is ever put back, and refills keep it
+    // in the buffer, so the pointer cannot leave the buffer here.
+    if (!eof_)
+        --cur_;
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::fill() {
+    if (eof_)
+        return false;
+    // The last buffer is kept, so that an error at its final line break
+    // can still point at the break.
+    const bool more = in_ ? in_->peek() != std::istream::traits_type::eof()
+                          : read_ < block_size_;
+    if (utf8_error_ != npos || cut_ || !more) {
+        if (validate_utf8_ && utf8_error_ == npos && utf8_.need)
+            // A sequence must not be cut by the end of input.
+            utf8_error_ = position();
+        eof_ = true;
+        return false;
+    }
+    // Lines are counted once per buffer, the counts are the checkpoints
+    // positions of errors are computed from.
+    const char *start = 0;
+    line_base_ += count_line_breaks(begin_, end_, end_, start, pending_cr_);
+    if (start)
+        line_start_ = base_ + (start - begin_);
+    base_ += end_ - begin_;
+    if (in_) {
+        begin_ = &buf_[0];
+        in_->read(&buf_[0], buf_.size());
+        end_ = begin_ + in_->gcount();
+    } else {
+        begin_ = block_;
+        end_ = block_ + block_size_;
+    }
+    cur_ = begin_;
+    read_ += end_ - begin_;
+    if (read_ > limits_.max_bytes) {
+        end_ -= read_ - limits_.max_bytes;
+        cut_ = true;
+    }
+    if (base_ == 0 && has_bom(begin_, end_))
+        cur_ += 3;
+    if (validate_utf8_)
+        check_utf8();
+    // A carriage return ending the previous buffer is a line break on its
+    // own unless a line feed follows.
+    if (pending_cr_ && (cur_ == end_ || *cur_ != '\n')) {
+        ++line_base_;
+        line_start_ = base_;
+    }
+    pending_cr_ = false;
+    eof_ = cur_ == end_;
+    return !eof_;
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::check_utf8() {
+    const char *bad = validate_utf8(cur_, end_, utf8_);
+    if (bad != end_) {
+        utf8_error_ = base_ + (bad - begin_);
+        end_ = bad;
+    }
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_gen(event &e) {
+    CONFIG_INI_STAT_SCOPE(STATE_GEN);
     for (;;) {
         const char c = get_char();
         if (handle_eof(e))
             return false;
+        if (Dialect::is_comment(c)) {
+            if (!skip_comment(e)) {
+                advance_eof(e);
+                return false;
+            }
+            continue;
+        }
         switch (c) {
         case '\r':
             check_lf();
+            // fallthrough
         case '\n':
-            handle_new_line();
+            CONFIG_INI_STAT(++stats_.whitespace_bytes);
             break;
-        case ';':
-            if (!skip_comment(e)) {
-                return false;
-            }
-            continue;
         case '[':
             return advance_section(e);
+        case '!':
+            return advance_directive(e);
         default:
-            if (std::isspace(c))
+            if (is_space(c)) {
+                CONFIG_INI_STAT(++stats_.whitespace_bytes);
                 continue;
-            if (std::isalnum(c)) {
-                put_back(c);
+            }
+            if (Dialect::is_key_start(c)) {
+                put_back();
                 return advance_param(e);
             }
             char buf[] = { 's', 'y',  'm', 'b',  'o', 'l',
@@ -120,174 +623,526 @@ bool parser::advance_gen(event &e) {
     }
 }
 
-bool parser::skip_comment(event &e) {
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::skip_comment(event &) {
+    /* Consuming symbols till the end of the string */
     for (;;) {
-        const char c = get_char();
-
-        switch (c) {
-        case '\r':
-            check_lf();
-        case '\n':
-            handle_new_line();
-            return in_.good();
-        default:
-            if (!in_)
-                return false;
-            /* Consuming symbols till the end of the string */
-            continue;
-        }
+        if (cur_ == end_ && !fill())
+            return false;
+        const char *p = cur_;
+        while (p != end_ && *p != '\n' && *p != '\r')
+            ++p;
+        CONFIG_INI_STAT(stats_.comment_bytes += p - cur_);
+        cur_ = p;
+        if (p != end_)
+            break;
     }
+    if (get_char() == '\r')
+        check_lf();
+    return true;
 }
 
-bool parser::advance_section(event &e) {
-    e.value.clear();
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_section(event &e) {
+    CONFIG_INI_STAT_SCOPE(STATE_SECTION);
     skip_ws();
+    tokens_.clear(e, cur_);
+    e.offset = position();
     for (;;) {
         const char c = get_char();
         if (handle_eof(e)) {
-            unexpected_token(e, "end of file");
+            // Unless the end was reported as an error already.
+            if (e.type == EVENT_END)
+                unexpected_token(e, "end of file");
             return false;
         }
-        switch (c) {
-        case ';':
+        if (Dialect::is_comment(c)) {
             unexpected_token(e, "comment");
             return false;
+        }
+        switch (c) {
         case '\r':
         case '\n':
             unexpected_token(e, "end of line");
             return false;
         case ']':
-            if (e.value.empty()) {
+            state_ = &parser_machine::advance_gen;
+            if (tokens_.size(e) == 0) {
                 unexpected_token(e, "]");
-            } else {
-                e.type = EVENT_SECTION;
+                return false;
             }
-            state_ = &parser::advance_gen;
-            trim_right(e.value);
+            e.type = EVENT_SECTION;
+            if (++entries_ > limits_.max_entries)
+                return exceed(e, limits::LIMIT_ENTRIES, "entries",
+                              limits_.max_entries);
+            trim_right(e);
+            e.length = tokens_.size(e);
             return true;
         default:
-            e.value.push_back(c);
+            if (tokens_.size(e) == limits_.max_section) {
+                put_back();
+                return exceed(e, limits::LIMIT_SECTION, "section name",
+                              limits_.max_section);
+            }
+            tokens_.take(e, c, cur_ - 1);
         }
     }
 }
 
-bool parser::advance_param(event &e) {
-    e.value.clear();
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_param(event &e) {
+    CONFIG_INI_STAT_SCOPE(STATE_PARAM);
+    tokens_.clear(e, cur_);
+    e.offset = position();
     for (;;) {
         const char c = get_char();
 
-        if (in_.eof()) {
-            state_ = &parser::advance_eof;
-            unexpected_token(e, "end of line");
+        if (eof_) {
+            state_ = &parser_machine::advance_eof;
+            if (!stop_early(e))
+                unexpected_token(e, "end of line");
             return false;
         }
 
-        switch (c) {
-        case ';':
+        if (Dialect::is_comment(c)) {
             unexpected_token(e, "comment");
             return false;
+        }
+        if (Dialect::is_delimiter(c)) {
+            if (++entries_ > limits_.max_entries)
+                return exceed(e, limits::LIMIT_ENTRIES, "entries",
+                              limits_.max_entries);
+            state_ = &parser_machine::advance_value;
+            e.type = EVENT_NAME;
+            trim_right(e);
+            e.length = tokens_.size(e);
+            return true;
+        }
+        switch (c) {
         case '\r':
             check_lf();
+            // fallthrough
         case '\n':
             unexpected_token(e, "new line");
             return false;
-        case '=':
-            state_ = &parser::advance_value;
-            e.type = EVENT_NAME;
-            trim_right(e.value);
-            return true;
         default:
-            e.value.push_back(c);
+            if (tokens_.size(e) == limits_.max_key) {
+                put_back();
+                return exceed(e, limits::LIMIT_KEY, "parameter name",
+                              limits_.max_key);
+            }
+            tokens_.take(e, c, cur_ - 1);
         }
     }
 }
 
-bool parser::advance_value(event &e) {
-    e.value.clear();
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_value(event &e) {
+    CONFIG_INI_STAT_SCOPE(STATE_VALUE);
     skip_ws();
+    tokens_.clear(e, cur_);
+    value_offset_ = position();
+    value_folded_ = 0;
+    value_emitted_ = 0;
+    if (cur_ != end_ && (*cur_ == '"' || *cur_ == '\'')) {
+        quote_ = get_char();
+        return advance_quoted(e);
+    }
+    return advance_plain(e);
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_plain(event &e) {
+    CONFIG_INI_STAT_SCOPE(STATE_VALUE);
+    resume_value(e);
+    // A run of blanks cannot be emitted before it is known to be inside
+    // the value, so the next attempt waits for another chunk.
+    std::size_t limit = chunk_size_;
     for (;;) {
+        if (chunk_size_ && tokens_.size(e) >= limit) {
+            if (emit_part(e, true))
+                return true;
+            limit = tokens_.size(e) + chunk_size_;
+        }
         const char c = get_char();
 
-        if (in_.eof()) {
+        if (eof_) {
             // Empty values at the end of file are ok
-            state_ = &parser::advance_eof;
+            state_ = &parser_machine::advance_eof;
+            if (stop_early(e))
+                return false;
             goto done;
         }
 
+        if (Dialect::is_comment(c)) {
+            if (!skip_comment(e)) {
+                state_ = &parser_machine::advance_eof;
+            } else {
+                state_ = &parser_machine::advance_gen;
+            }
+            goto done;
+        }
         switch (c) {
         case '\r':
             check_lf();
+            // fallthrough
         case '\n':
-            handle_new_line();
-            state_ = &parser::advance_gen;
+            state_ = &parser_machine::advance_gen;
             goto done;
-        case ';':
-            if (!skip_comment(e)) {
-                state_ = &parser::advance_eof;
-            } else {
-                state_ = &parser::advance_gen;
+        case '\\': {
+            // Still in the buffer storage if continue_line() refills it.
+            const char *p = cur_ - 1;
+            const std::size_t from = position() - 1;
+            if (continue_line()) {
+                value_folded_ += position() - from;
+                continue;
             }
-            goto done;
+            if (value_emitted_ + tokens_.size(e) == limits_.max_value)
+                return exceed(e, limits::LIMIT_VALUE, "value",
+                              limits_.max_value);
+            tokens_.take(e, c, p);
+            break;
+        }
         default:
-            e.value.push_back(c);
+            if (value_emitted_ + tokens_.size(e) == limits_.max_value) {
+                put_back();
+                return exceed(e, limits::LIMIT_VALUE, "value",
+                              limits_.max_value);
+            }
+            tokens_.take(e, c, cur_ - 1);
         }
     }
 done:
     e.type = EVENT_VALUE;
-    trim_right(e.value);
+    trim_right(e);
+    // Apart from line continuations value bytes are copied verbatim, so
+    // the source range is the trimmed value plus the folded bytes.
+    e.length = value_emitted_ + tokens_.size(e) + value_folded_;
     return true;
 }
 
-bool parser::advance_eof(event &e) {
-    state_ = &parser::advance_eof;
+/**
+ * Continues a value after an emitted part with the bytes held back.
+ */
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::resume_value(event &e) {
+    tokens_.resume(e);
+    e.offset = value_offset_;
+}
+
+/**
+ * Emits the value read so far as a part, holding trailing blanks back
+ * if \p trim is set.  Returns false if there is nothing to emit.
+ */
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::emit_part(event &e, bool trim) {
+    std::size_t n = tokens_.size(e);
+    if (trim) {
+        const char *data = tokens_.data(e);
+        while (n && is_space(data[n - 1]))
+            --n;
+    }
+    if (n == 0)
+        return false;
+    tokens_.hold(e, n);
+    value_emitted_ += n;
+    e.type = EVENT_VALUE_PART;
+    e.length = 0;
+    state_ = trim ? &parser_machine::advance_plain
+                  : &parser_machine::advance_quoted;
+    return true;
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::continue_line() {
+    const char c = get_char();
+    switch (c) {
+    case '\r':
+        check_lf();
+        // fallthrough
+    case '\n':
+        // Indentation of the continuation line is not part of the value.
+        skip_ws();
+        return true;
+    default:
+        put_back();
+        return false;
+    }
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_quoted(event &e) {
+    CONFIG_INI_STAT_SCOPE(STATE_VALUE);
+    resume_value(e);
+    for (;;) {
+        if (cur_ == end_ && !fill()) {
+            state_ = &parser_machine::advance_eof;
+            if (!stop_early(e))
+                unexpected_token(e, "end of file");
+            return false;
+        }
+        // Plain runs are appended in bulk, the decoding slow path is only
+        // taken for escape sequences.
+        const char *p = find_quoted_special(cur_, end_, quote_);
+        if (chunk_size_) {
+            const std::size_t size = tokens_.size(e);
+            const std::size_t room = size < chunk_size_ ? chunk_size_ - size
+                                                        : 0;
+            if (static_cast<std::size_t>(p - cur_) > room)
+                p = cur_ + room;
+        }
+        const std::size_t room = limits_.max_value - value_emitted_ -
+                                 tokens_.size(e);
+        if (static_cast<std::size_t>(p - cur_) > room) {
+            cur_ += room;
+            return exceed(e, limits::LIMIT_VALUE, "value", limits_.max_value);
+        }
+        tokens_.append(e, cur_, p);
+        cur_ = p;
+        if (chunk_size_ && tokens_.size(e) >= chunk_size_)
+            return emit_part(e, false);
+        if (p == end_)
+            continue;
+
+        const char c = get_char();
+        if (c == quote_)
+            break;
+        if (c == '\\') {
+            const char escaped = get_char();
+            if (!eof_ && escaped != '\n' && escaped != '\r') {
+                if (value_emitted_ + tokens_.size(e) == limits_.max_value)
+                    return exceed(e, limits::LIMIT_VALUE, "value",
+                                  limits_.max_value);
+                tokens_.put(e, unescape(escaped));
+                continue;
+            }
+        }
+        put_back();
+        state_ = &parser_machine::advance_eof;
+        if (!stop_early(e))
+            unexpected_token(e, eof_ ? "end of file" : "end of line");
+        return false;
+    }
+    e.type = EVENT_VALUE;
+    e.length = position() - value_offset_;
+
+    // Only a comment may follow the closing quote.
+    skip_ws();
+    const char c = get_char();
+    if (Dialect::is_comment(c)) {
+        state_ = skip_comment(e) ? &parser_machine::advance_gen
+                                 : &parser_machine::advance_eof;
+        return true;
+    }
+    switch (c) {
+    case '\r':
+        check_lf();
+        // fallthrough
+    case '\n':
+        state_ = &parser_machine::advance_gen;
+        return true;
+    default:
+        if (eof_) {
+            state_ = &parser_machine::advance_eof;
+            return true;
+        }
+        char buf[] = { 's', 'y',  'm', 'b',  'o', 'l',
+                       ' ', '\'', c,   '\'', '\0' };
+        unexpected_token(e, buf);
+        return false;
+    }
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_directive(event &e) {
+    tokens_.clear(e, cur_);
+    for (;;) {
+        const char c = get_char();
+        if (eof_)
+            break;
+        if (is_space(c)) {
+            put_back();
+            break;
+        }
+        // Longer words cannot be a known directive.
+        if (tokens_.size(e) > 7)
+            break;
+        tokens_.take(e, c, cur_ - 1);
+    }
+    if (stop_early(e))
+        return false;
+    if (tokens_.size(e) != 7 ||
+        std::memcmp(tokens_.data(e), "include", 7) != 0) {
+        unexpected_token(e, "symbol '!'");
+        return false;
+    }
+
+    skip_ws();
+    tokens_.clear(e, cur_);
+    e.offset = position();
+    for (;;) {
+        const char c = get_char();
+        if (eof_)
+            break;
+        if (c == '\r' || c == '\n' || Dialect::is_comment(c)) {
+            // Line end and comment are left to advance_gen.
+            put_back();
+            break;
+        }
+        if (tokens_.size(e) == limits_.max_value) {
+            put_back();
+            return exceed(e, limits::LIMIT_VALUE, "include path",
+                          limits_.max_value);
+        }
+        tokens_.take(e, c, cur_ - 1);
+    }
+    if (stop_early(e))
+        return false;
+    trim_right(e);
+    if (tokens_.size(e) == 0) {
+        unexpected_token(e, "end of line");
+        return false;
+    }
+    if (++entries_ > limits_.max_entries)
+        return exceed(e, limits::LIMIT_ENTRIES, "entries",
+                      limits_.max_entries);
+    e.type = EVENT_INCLUDE;
+    e.length = tokens_.size(e);
+    return true;
+}
+
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::advance_eof(event &e) {
+    state_ = &parser_machine::advance_eof;
+    if (stop_early(e))
+        return false;
     e.type = EVENT_END;
-    e.value.clear();
+    tokens_.clear(e, cur_);
+    e.offset = position();
+    e.length = 0;
     return false;
 }
 
-bool parser::handle_eof(event &e) {
-    const bool eof = in_.eof();
-    if (eof)
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::handle_eof(event &e) {
+    if (eof_)
         advance_eof(e);
-    return eof;
+    return eof_;
+}
+
+/**
+ * Reports the reason if the input ended before its real end: at an
+ * invalid UTF-8 sequence or at the max_bytes cut.  Returns false if the
+ * input really ended, so the caller handles the end of file itself.
+ */
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::stop_early(event &e) {
+    if (!eof_ || stopped_ || exceeded_ != limits::LIMIT_NONE)
+        return false;
+    if (utf8_error_ != npos) {
+        // The sequence precedes the cut, if any.
+        stopped_ = true;
+        state_ = &parser_machine::advance_eof;
+        unexpected_token(e, "invalid UTF-8 sequence");
+        return true;
+    }
+    if (!cut_)
+        return false;
+    stopped_ = true;
+    exceed(e, limits::LIMIT_BYTES, "input", limits_.max_bytes);
+    return true;
 }
 
-bool parser::skip_ws() {
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::skip_ws() {
     char c;
-    while (in_ && std::isspace(c = get_char()))
-        ;
-    const bool ok = in_.good();
-    if (ok)
-        put_back(c);
-    return ok;
+    // Line breaks terminate sections and values, so they are never
+    // skipped here.
+    while ((c = get_char()) != '\n' && c != '\r' && is_space(c))
+        CONFIG_INI_STAT(++stats_.whitespace_bytes);
+    put_back();
+    return !eof_;
 }
 
-void parser::check_lf() {
-    const char c = get_char();
-    if (c != '\n')
-        put_back(c);
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::check_lf() {
+    if (get_char() != '\n')
+        put_back();
+}
+
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::unexpected_token(event &e,
+                                                       const char *desc) {
+    char message[96];
+    chars::bounded_writer w(message, sizeof(message));
+    w << "Unexpected token: " << desc;
+    report(e, message);
+}
+
+/**
+ * Stops parsing because the limit \p kind is exceeded by \p what.
+ * Always returns false.
+ */
+template <typename Dialect, typename Tokens>
+bool parser_machine<Dialect, Tokens>::exceed(event &e, limits::kind kind,
+                                             const char *what,
+                                             std::size_t max) {
+    char message[96];
+    chars::bounded_writer w(message, sizeof(message));
+    if (kind == limits::LIMIT_ENTRIES)
+        w << "more than " << max << " entries";
+    else
+        w << what << " longer than " << max << " bytes";
+    exceeded_ = kind;
+    state_ = &parser_machine::advance_eof;
+    report(e, message);
+    return false;
 }
 
-void parser::handle_new_line() {
-    column_ = 1;
-    ++line_;
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::trim_right(event &e) {
+    const char *data = tokens_.data(e);
+    const std::size_t n = tokens_.size(e);
+    std::size_t i = n;
+    while (i && is_space(data[i - 1]))
+        --i;
+    if (i != n)
+        tokens_.truncate(e, i);
 }
 
-void parser::unexpected_token(event &e, const char *desc) {
-    std::ostringstream ss(e.value);
-    ss << filename_ << ":" << line_ << ":" << column_
-       << ": Unexpected token: " << desc;
+template <typename Dialect, typename Tokens>
+void parser_machine<Dialect, Tokens>::report(event &e, const char *message) {
+    CONFIG_INI_STAT(++stats_.errors);
+    // Point at a line break that ended the token rather than past it.
+    const char *p = cur_;
+    if (p != begin_ && (p[-1] == '\n' || p[-1] == '\r'))
+        --p;
+    std::size_t line, column;
+    locate(p, line, column);
+    tokens_.error(e, line, column, message);
     e.type = EVENT_ERROR;
-    e.value = ss.str();
+    e.offset = position();
+    e.length = 0;
 }
 
-bool operator==(const parser::event &lhs, const parser::event &rhs) {
+bool operator==(const parser_base::event &lhs,
+                const parser_base::event &rhs) {
     return lhs.type == rhs.type && lhs.value == rhs.value;
 }
 
-std::ostream &operator<<(std::ostream &os, const parser::event &e) {
+std::ostream &operator<<(std::ostream &os, const parser_base::event &e) {
     os << "event{" << event_type_to_string(e.type) << ", \"" << e.value
        << "\"}";
+    return os;
 }
+
+template class parser_machine<default_dialect, string_tokens>;
+template class parser_machine<relaxed_dialect, string_tokens>;
+template class parser_machine<default_dialect, view_tokens>;
+template class parser_machine<relaxed_dialect, view_tokens>;
+template class parser_machine<default_dialect, resource_tokens>;
+template class parser_machine<relaxed_dialect, resource_tokens>;
+template class basic_parser<default_dialect>;
+template class basic_parser<relaxed_dialect>;
 }
 }
@@ -0,0 +1,263 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail Values are split into literal and reference pieces once per
+ * load.  Expansion is a depth-first walk over the reference graph with
+ * an explicit stack, so long reference chains do not exhaust the call
+ * stack; a node found on the stack again means a cycle.
+ */
+
+#include "config/ini/interpolator.hpp"
+#include "config/ini/document.hpp"
+#include <cstdlib>
+
+namespace config {
+namespace ini {
+
+namespace {
+const std::size_t npos = static_cast<std::size_t>(-1);
+
+std::string describe(const std::pair<std::string, std::string> &k) {
+    return "[" + k.first + "] " + k.second;
+}
+}
+
+interpolator::interpolator() : expansions_(0) {}
+
+bool interpolator::resolve(const document &doc) {
+    nodes_.clear();
+    index_.clear();
+    env_.clear();
+    return reload(doc);
+}
+
+bool interpolator::reload(const document &doc) {
+    std::vector<node> old_nodes;
+    std::map<key, std::size_t> old_index;
+    nodes_.swap(old_nodes);
+    index_.swap(old_index);
+    error_.clear();
+    expansions_ = 0;
+
+    const document::string_vector &sections = doc.sections();
+    const document::param_vector &params = doc.params();
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        const string &section = sections[params[i].section];
+        const string &name = params[i].name;
+        const key k(std::string(section.data(), section.size()),
+                    std::string(name.data(), name.size()));
+        const std::pair<std::map<key, std::size_t>::iterator, bool> r =
+            index_.insert(std::make_pair(k, nodes_.size()));
+        if (r.second) {
+            nodes_.push_back(node());
+            nodes_.back().name = &r.first->first;
+        }
+        // Lists are expanded by their last value, like document::get().
+        const document::value_range values = doc.values(params[i]);
+        const string &raw = values.first[values.count - 1];
+        nodes_[r.first->second].raw.assign(raw.data(), raw.size());
+    }
+
+    // Values that did not change keep their expansion unless something
+    // they refer to changed.
+    std::map<std::string, std::string> env;
+    std::vector<std::size_t> dirty;
+    for (std::size_t i = 0; i < nodes_.size(); ++i) {
+        node &n = nodes_[i];
+        split(n.raw, n.pieces);
+
+        bool changed = true;
+        const std::map<key, std::size_t>::const_iterator old =
+            old_index.find(*n.name);
+        if (old != old_index.end()) {
+            node &o = old_nodes[old->second];
+            if (o.state == RESOLVED && o.raw == n.raw) {
+                n.value.swap(o.value);
+                changed = false;
+            }
+        }
+
+        for (std::size_t j = 0; j < n.pieces.size(); ++j) {
+            piece &p = n.pieces[j];
+            if (p.type == piece::REF) {
+                const std::size_t colon = p.text.find(':');
+                const std::map<key, std::size_t>::const_iterator it =
+                    index_.find(key(p.text.substr(0, colon),
+                                    p.text.substr(colon + 1)));
+                p.node = it == index_.end() ? npos : it->second;
+                if (p.node == npos)
+                    changed = true;
+                else
+                    nodes_[p.node].dependents.push_back(i);
+            } else if (p.type == piece::ENV) {
+                const char *value = std::getenv(p.text.c_str());
+                std::string &cur = env[p.text];
+                cur = value ? value : "";
+                const std::map<std::string, std::string>::const_iterator e =
+                    env_.find(p.text);
+                if (e == env_.end() || e->second != cur)
+                    changed = true;
+            }
+        }
+
+        n.state = changed ? UNRESOLVED : RESOLVED;
+        if (changed)
+            dirty.push_back(i);
+    }
+    env_.swap(env);
+
+    while (!dirty.empty()) {
+        const std::size_t i = dirty.back();
+        dirty.pop_back();
+        const std::vector<std::size_t> &deps = nodes_[i].dependents;
+        for (std::size_t j = 0; j < deps.size(); ++j) {
+            if (nodes_[deps[j]].state == RESOLVED) {
+                nodes_[deps[j]].state = UNRESOLVED;
+                dirty.push_back(deps[j]);
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < nodes_.size(); ++i) {
+        if (nodes_[i].state == UNRESOLVED && !expand(i))
+            return false;
+    }
+    return true;
+}
+
+const std::string *interpolator::get(const std::string &section,
+                                     const std::string &name) const {
+    const std::map<key, std::size_t>::const_iterator it =
+        index_.find(key(section, name));
+    if (it == index_.end() || nodes_[it->second].state != RESOLVED)
+        return 0;
+    return &nodes_[it->second].value;
+}
+
+void interpolator::split(const std::string &raw,
+                         std::vector<piece> &pieces) const {
+    pieces.clear();
+    std::string text;
+    std::size_t pos = 0;
+    for (;;) {
+        const std::size_t dollar = raw.find('$', pos);
+        text.append(raw, pos, dollar - pos);
+        if (dollar == std::string::npos)
+            break;
+        pos = dollar + 1;
+        if (pos < raw.size() && raw[pos] == '$') {
+            text.push_back('$');
+            ++pos;
+            continue;
+        }
+        const std::size_t close = raw.find('}', pos);
+        if (pos == raw.size() || raw[pos] != '{' ||
+            close == std::string::npos) {
+            text.push_back('$');
+            continue;
+        }
+        if (!text.empty()) {
+            const piece t = { piece::TEXT, text, npos };
+            pieces.push_back(t);
+            text.clear();
+        }
+        const std::string ref = raw.substr(pos + 1, close - pos - 1);
+        const piece r = { ref.find(':') == std::string::npos ? piece::ENV
+                                                             : piece::REF,
+                          ref, npos };
+        pieces.push_back(r);
+        pos = close + 1;
+    }
+    if (!text.empty()) {
+        const piece t = { piece::TEXT, text, npos };
+        pieces.push_back(t);
+    }
+}
+
+bool interpolator::expand(std::size_t root) {
+    // Each frame is a node and the index of the next piece to look at.
+    std::vector<std::pair<std::size_t, std::size_t> > stack;
+    stack.push_back(std::make_pair(root, std::size_t(0)));
+    nodes_[root].state = VISITING;
+
+    while (!stack.empty()) {
+        std::pair<std::size_t, std::size_t> &top = stack.back();
+        node &n = nodes_[top.first];
+        std::size_t next = npos;
+
+        while (top.second < n.pieces.size()) {
+            const piece &p = n.pieces[top.second++];
+            if (p.type != piece::REF)
+                continue;
+            if (p.node == npos) {
+                return fail(describe(*n.name) + ": unresolved reference ${" +
+                            p.text + "}");
+            }
+            const node &dep = nodes_[p.node];
+            if (dep.state == RESOLVED)
+                continue;
+            if (dep.state == VISITING) {
+                std::string chain;
+                std::size_t i = 0;
+                while (stack[i].first != p.node)
+                    ++i;
+                for (; i < stack.size(); ++i)
+                    chain.append(describe(*nodes_[stack[i].first].name))
+                        .append(" -> ");
+                return fail("reference cycle: " + chain + describe(*dep.name));
+            }
+            next = p.node;
+            break;
+        }
+
+        if (next != npos) {
+            nodes_[next].state = VISITING;
+            stack.push_back(std::make_pair(next, std::size_t(0)));
+            continue;
+        }
+
+        // Everything this node refers to is expanded already.
+        n.value.clear();
+        for (std::size_t i = 0; i < n.pieces.size(); ++i) {
+            const piece &p = n.pieces[i];
+            switch (p.type) {
+            case piece::TEXT:
+                n.value.append(p.text);
+                break;
+            case piece::REF:
+                n.value.append(nodes_[p.node].value);
+                break;
+            case piece::ENV:
+                n.value.append(env_.find(p.text)->second);
+                break;
+            }
+        }
+        n.state = RESOLVED;
+        ++expansions_;
+        stack.pop_back();
+    }
+    return true;
+}
+
+bool interpolator::fail(const std::string &message) {
+    error_ = message;
+    return false;
+}
+}
+}
@@ -0,0 +1,239 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The merged index is filled from the top layer down and a key
+ * is only inserted if it is not there yet, so every entry refers to the
+ * winning parameter.  Entries keep the key hash to skip string
+ * comparisons of colliding keys.
+ */
+
+#include "config/ini/layered.hpp"
+#include "hash.hpp"
+#include <cctype>
+
+extern char **environ;
+
+namespace config {
+namespace ini {
+
+namespace {
+struct setting {
+    std::string section;
+    std::string name;
+    std::string value;
+};
+
+/**
+ * Adds settings to the document grouped by section in order of first
+ * appearance, so that no section is repeated.
+ */
+bool add_settings(const std::vector<setting> &settings, document &out) {
+    std::vector<bool> done(settings.size());
+    for (std::size_t i = 0; i < settings.size(); ++i) {
+        if (done[i])
+            continue;
+        if (!out.add_section(settings[i].section))
+            return false;
+        for (std::size_t j = i; j < settings.size(); ++j) {
+            if (done[j] || settings[j].section != settings[i].section)
+                continue;
+            done[j] = true;
+            if (!out.add_param(settings[j].name, settings[j].value))
+                return false;
+        }
+    }
+    return true;
+}
+
+std::string lower(const std::string &s) {
+    std::string r(s);
+    for (std::size_t i = 0; i < r.size(); ++i)
+        r[i] = std::tolower(static_cast<unsigned char>(r[i]));
+    return r;
+}
+}
+
+layered::layered() {}
+
+void layered::push(const document &layer) {
+    layers_.push_back(&layer);
+    entries_.clear();
+    slots_.clear();
+}
+
+void layered::clear() {
+    layers_.clear();
+    entries_.clear();
+    slots_.clear();
+}
+
+void layered::flatten() {
+    entries_.clear();
+    slots_.clear();
+    if (layers_.empty())
+        return;
+
+    std::size_t total = 0;
+    for (std::size_t l = 0; l < layers_.size(); ++l)
+        total += layers_[l]->params().size();
+    std::size_t size = 16;
+    while (size < 2 * total)
+        size *= 2;
+    slots_.resize(size);
+    const std::size_t mask = size - 1;
+    const bool fold = layers_[0]->get_options().case_insensitive;
+
+    for (std::size_t l = layers_.size(); l-- > 0;) {
+        const document &doc = *layers_[l];
+        const document::param_vector &params = doc.params();
+        for (std::size_t p = 0; p < params.size(); ++p) {
+            const string &section = doc.sections()[params[p].section];
+            const string &name = params[p].name;
+            const uint32_t h = hash::key_hash(section, name, fold);
+            std::size_t s = h & mask;
+            for (; slots_[s]; s = (s + 1) & mask) {
+                const entry &e = entries_[slots_[s] - 1];
+                if (e.hash != h)
+                    continue;
+                const document &other = *layers_[e.layer];
+                const document::param &q = other.params()[e.param];
+                const string &qs = other.sections()[q.section];
+                if (hash::equal(q.name.data(), q.name.size(), name, fold) &&
+                    hash::equal(qs.data(), qs.size(), section, fold))
+                    break;
+            }
+            if (slots_[s])
+                continue;
+            const entry e = { h, static_cast<uint32_t>(l), p };
+            entries_.push_back(e);
+            slots_[s] = entries_.size();
+        }
+    }
+}
+
+const document::param *layered::find(const std::string &section,
+                                     const std::string &name,
+                                     const document *&layer) const {
+    const bool fold = layers_[0]->get_options().case_insensitive;
+    const uint32_t h = hash::key_hash(section, name, fold);
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t s = h & mask; slots_[s]; s = (s + 1) & mask) {
+        const entry &e = entries_[slots_[s] - 1];
+        if (e.hash != h)
+            continue;
+        const document &doc = *layers_[e.layer];
+        const document::param &p = doc.params()[e.param];
+        const string &ps = doc.sections()[p.section];
+        if (hash::equal(p.name.data(), p.name.size(), name, fold) &&
+            hash::equal(ps.data(), ps.size(), section, fold)) {
+            layer = &doc;
+            return &p;
+        }
+    }
+    return 0;
+}
+
+const string *layered::get(const std::string &section,
+                           const std::string &name) const {
+    if (slots_.empty()) {
+        for (std::size_t l = layers_.size(); l-- > 0;)
+            if (const string *v = layers_[l]->get(section, name))
+                return v;
+        return 0;
+    }
+    const document *layer;
+    const document::param *p = find(section, name, layer);
+    if (!p || !p->count)
+        return 0;
+    return layer->values(*p).end() - 1;
+}
+
+document::value_range layered::get_all(const std::string &section,
+                                       const std::string &name) const {
+    if (slots_.empty()) {
+        for (std::size_t l = layers_.size(); l-- > 0;) {
+            const document::value_range r = layers_[l]->get_all(section,
+                                                                name);
+            if (!r.empty())
+                return r;
+        }
+        const document::value_range none = { 0, 0 };
+        return none;
+    }
+    const document *layer;
+    const document::param *p = find(section, name, layer);
+    if (!p) {
+        const document::value_range none = { 0, 0 };
+        return none;
+    }
+    return layer->values(*p);
+}
+
+bool load_environment(const std::string &prefix, document &out) {
+    std::vector<setting> settings;
+    for (char **env = environ; env && *env; ++env) {
+        const std::string var(*env);
+        const std::size_t eq = var.find('=');
+        if (eq == std::string::npos || eq <= prefix.size() ||
+            var.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        const std::string key = var.substr(prefix.size(),
+                                           eq - prefix.size());
+        const std::size_t sep = key.find("__");
+        setting s;
+        if (sep != std::string::npos) {
+            s.section = lower(key.substr(0, sep));
+            s.name = lower(key.substr(sep + 2));
+        } else {
+            s.name = lower(key);
+        }
+        s.value = var.substr(eq + 1);
+        settings.push_back(s);
+    }
+    return add_settings(settings, out);
+}
+
+bool load_arguments(int argc, const char *const *argv, document &out,
+                    std::vector<std::string> *rest) {
+    std::vector<setting> settings;
+    for (int i = 0; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const std::size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos ||
+            eq == 2) {
+            if (rest)
+                rest->push_back(arg);
+            continue;
+        }
+        const std::string key = arg.substr(2, eq - 2);
+        const std::size_t dot = key.rfind('.');
+        setting s;
+        if (dot != std::string::npos) {
+            s.section = key.substr(0, dot);
+            s.name = key.substr(dot + 1);
+        } else {
+            s.name = key;
+        }
+        s.value = arg.substr(eq + 1);
+        settings.push_back(s);
+    }
+    return add_settings(settings, out);
+}
+}
+}
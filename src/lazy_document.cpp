@@ -0,0 +1,299 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The prescan looks at every line once, mostly with memchr.  Like
+ * the parser, it breaks lines on "\n", "\r\n" and a lone "\r".  A
+ * line starts a section if its first non-blank character is '[' and it
+ * does not continue a value.  A value continues on the next line if its
+ * line ends with a backslash, is not quoted and contains no comment;
+ * these are the rules the parser applies, so the prescan never cuts a
+ * value in two.
+ *
+ * Sections are parsed by the regular parser reading straight from the
+ * mapping through a memory stream buffer.  The parser is told where the
+ * range starts, so offsets and error positions refer to the whole file.
+ */
+
+#include "config/ini/lazy_document.hpp"
+#include "config/ini/parser.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace config {
+namespace ini {
+
+namespace {
+/**
+ * Input buffer over a memory range.
+ */
+class memory_buf : public std::streambuf {
+public:
+    memory_buf(const char *data, std::size_t size) {
+        char *p = const_cast<char *>(data);
+        setg(p, p, p + size);
+    }
+};
+
+bool is_blank(char c) { return c == ' ' || c == '\t'; }
+
+const char *skip_blanks(const char *p, const char *end) {
+    while (p != end && is_blank(*p))
+        ++p;
+    return p;
+}
+
+/**
+ * Returns the first line break in [p, end) or end.
+ */
+const char *find_break(const char *p, const char *end) {
+    const char *lf = static_cast<const char *>(
+        std::memchr(p, '\n', end - p));
+    if (!lf)
+        lf = end;
+    const char *cr = static_cast<const char *>(
+        std::memchr(p, '\r', lf - p));
+    return cr ? cr : lf;
+}
+
+/**
+ * Returns true if the value on the line [p, end) continues on the next
+ * line.  \p value is the start of the value or null if the line is a
+ * continuation itself.
+ */
+bool continues(const char *p, const char *end, const char *value) {
+    if (std::memchr(p, ';', end - p))
+        return false;
+    if (value) {
+        value = skip_blanks(value, end);
+        if (value != end && (*value == '"' || *value == '\''))
+            return false;
+    }
+    return end != p && end[-1] == '\\';
+}
+}
+
+lazy_document::lazy_document(const document::options &opts)
+    : doc_(opts)
+    , data_(0)
+    , size_(0)
+    , loaded_(0)
+{}
+
+lazy_document::~lazy_document() { close(); }
+
+void lazy_document::close() {
+    if (data_)
+        ::munmap(const_cast<char *>(data_), size_);
+    data_ = 0;
+    size_ = 0;
+    loaded_ = 0;
+    index_.clear();
+    doc_.clear();
+}
+
+bool lazy_document::open(const std::string &path) {
+    close();
+    error_.clear();
+    path_ = path;
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error_ = path + ": open: " + std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        error_ = path + ": fstat: " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void *p = ::mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            error_ = path + ": mmap: " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        data_ = static_cast<const char *>(p);
+        size_ = st.st_size;
+    }
+    ::close(fd);
+    scan();
+    return true;
+}
+
+std::string lazy_document::key(const std::string &section) const {
+    if (!doc_.get_options().case_insensitive)
+        return section;
+    std::string k(section);
+    for (std::size_t i = 0; i < k.size(); ++i)
+        if (k[i] >= 'A' && k[i] <= 'Z')
+            k[i] = k[i] - 'A' + 'a';
+    return k;
+}
+
+void lazy_document::scan() {
+    const char *const end = data_ + size_;
+    const char *p = data_;
+    std::size_t line = 1;
+    bool continued = false;
+
+    // Parameters preceding the first header belong to the section "",
+    // which only exists if there are any.
+    range current = { 0, 0, 1 };
+    std::string name;
+    bool top = false;
+    // A header was seen, so current is a section even if it is empty.
+    bool in_section = false;
+    if (size_ >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+        p += 3;
+
+    while (p != end) {
+        const char *eol = find_break(p, end);
+        const char *s = skip_blanks(p, eol);
+        if (!continued && s != eol && *s == '[') {
+            current.length = p - data_ - current.offset;
+            if (in_section || top)
+                index_[key(name)].ranges.push_back(current);
+            const char *close = static_cast<const char *>(
+                std::memchr(s, ']', eol - s));
+            const char *first = skip_blanks(s + 1, close ? close : eol);
+            const char *last = close ? close : eol;
+            while (last != first && std::isspace(
+                       static_cast<unsigned char>(last[-1])))
+                --last;
+            name.assign(first, last);
+            current.offset = p - data_;
+            current.line = line;
+            in_section = true;
+        } else if (continued) {
+            continued = continues(s, eol, 0);
+        } else if (s != eol && *s != ';') {
+            const char *eq = static_cast<const char *>(
+                std::memchr(s, '=', eol - s));
+            continued = eq && continues(s, eol, eq + 1);
+            top = true;
+        }
+        if (eol != end && *eol == '\r' && eol + 1 != end && eol[1] == '\n')
+            ++eol;
+        p = eol == end ? end : eol + 1;
+        ++line;
+    }
+    current.length = size_ - current.offset;
+    if (in_section || top)
+        index_[key(name)].ranges.push_back(current);
+
+    for (std::map<std::string, section_entry>::iterator it = index_.begin();
+         it != index_.end(); ++it)
+        it->second.loaded = false;
+}
+
+bool lazy_document::load_section(const std::string &section) {
+    const std::map<std::string, section_entry>::iterator it =
+        index_.find(key(section));
+    if (it == index_.end())
+        return true;
+    section_entry &entry = it->second;
+    if (entry.loaded) {
+        if (entry.error.empty())
+            return true;
+        error_ = entry.error;
+        return false;
+    }
+    error_.clear();
+    // Params of the ranges parsed before an error stay in the document,
+    // so a failed section is never parsed again.
+    entry.loaded = true;
+    for (std::size_t i = 0; i < entry.ranges.size(); ++i) {
+        if (!parse(section, entry.ranges[i])) {
+            entry.error = error_;
+            return false;
+        }
+    }
+    ++loaded_;
+    return true;
+}
+
+bool lazy_document::parse(const std::string &section, const range &r) {
+    memory_buf buf(data_ + r.offset, r.length);
+    std::istream in(&buf);
+    parser p(path_, in);
+    p.set_origin(r.offset, r.line);
+
+    // The range of the section "" has no header.
+    if (section.empty() && r.offset == 0 && !doc_.add_section(section)) {
+        error_ = path_ + ": " + doc_.error();
+        return false;
+    }
+    parser::event e;
+    std::string name;
+    while (p.advance(e)) {
+        bool ok = true;
+        switch (e.type) {
+        case parser::EVENT_SECTION:
+            ok = doc_.add_section(e.value);
+            break;
+        case parser::EVENT_NAME:
+            name = e.value;
+            break;
+        case parser::EVENT_VALUE:
+            ok = doc_.add_param(name, e.value);
+            break;
+        case parser::EVENT_INCLUDE:
+            error_ = path_ + ": !include is not supported by lazy_document";
+            return false;
+        default:
+            break;
+        }
+        if (!ok) {
+            error_ = path_ + ": " + doc_.error();
+            return false;
+        }
+    }
+    if (e.type == parser::EVENT_ERROR) {
+        error_ = e.value;
+        return false;
+    }
+    return true;
+}
+
+const string *lazy_document::get(const std::string &section,
+                                 const std::string &name) {
+    if (!load_section(section))
+        return 0;
+    return doc_.get(section, name);
+}
+
+document::value_range lazy_document::get_all(const std::string &section,
+                                             const std::string &name) {
+    if (!load_section(section)) {
+        const document::value_range none = { 0, 0 };
+        return none;
+    }
+    return doc_.get_all(section, name);
+}
+}
+}
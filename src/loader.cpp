@@ -0,0 +1,217 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "config/ini/loader.hpp"
+#include "config/ini/document.hpp"
+#include "config/ini/readahead.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <limits.h>
+#include <stdlib.h>
+
+namespace config {
+namespace ini {
+
+namespace {
+bool canonical_path(const std::string &path, std::string &out) {
+    char buf[PATH_MAX];
+    if (!realpath(path.c_str(), buf))
+        return false;
+    out.assign(buf);
+    return true;
+}
+
+std::string resolve(const std::string &base, const std::string &path) {
+    if (!path.empty() && path[0] == '/')
+        return path;
+    const std::size_t slash = base.rfind('/');
+    return slash == std::string::npos ? path
+                                      : base.substr(0, slash + 1) + path;
+}
+
+parser::event error_event(const std::string &message) {
+    parser::event e;
+    e.type = parser::EVENT_ERROR;
+    e.value = message;
+    e.offset = e.length = 0;
+    return e;
+}
+}
+
+loader::loader()
+    : exceeded_(parser::limits::LIMIT_NONE)
+    , entries_(0)
+    , readahead_(false)
+{}
+
+bool loader::load(const std::string &path, document &doc) {
+    error_.clear();
+    stack_.clear();
+    exceeded_ = parser::limits::LIMIT_NONE;
+    entries_ = 0;
+    return include(path, doc);
+}
+
+void loader::set_limits(const parser::limits &l) {
+    limits_ = l;
+    parser_.set_limits(l);
+    cache_.clear();
+}
+
+void loader::clear_cache() { cache_.clear(); }
+
+void loader::files(std::vector<std::string> &out) const {
+    for (std::map<std::string, parsed_file>::const_iterator it =
+             cache_.begin();
+         it != cache_.end(); ++it)
+        out.push_back(it->first);
+}
+
+const loader::parsed_file &loader::parse(const std::string &path) {
+    const std::map<std::string, parsed_file>::iterator it =
+        cache_.find(path);
+    if (it != cache_.end())
+        return it->second;
+
+    parsed_file &f = cache_[path];
+    f.exceeded = parser::limits::LIMIT_NONE;
+    std::ifstream file;
+    readahead_buf ahead;
+    std::istream in(0);
+    if (readahead_) {
+        if (!ahead.open(path)) {
+            f.evs.push_back(error_event(ahead.error()));
+            return f;
+        }
+        in.rdbuf(&ahead);
+    } else {
+        file.open(path.c_str());
+        if (!file.is_open()) {
+            f.evs.push_back(error_event(path + ": cannot open file"));
+            return f;
+        }
+        in.rdbuf(file.rdbuf());
+    }
+    parser_.reset(in, path);
+    parser::event e;
+    while (parser_.advance(e))
+        f.evs.push_back(e);
+    if (e.type == parser::EVENT_ERROR)
+        f.evs.push_back(e);
+    f.exceeded = parser_.exceeded_limit();
+    if (in.bad() || !ahead.error().empty()) {
+        // The events of a partly read file are not trusted.
+        f.evs.clear();
+        f.evs.push_back(error_event(
+            ahead.error().empty() ? path + ": read error" : ahead.error()));
+    }
+    return f;
+}
+
+bool loader::include(const std::string &path, document &doc) {
+    std::string canonical;
+    if (!canonical_path(path, canonical))
+        return fail(path + ": cannot open file");
+
+    if (std::find(stack_.begin(), stack_.end(), canonical) != stack_.end()) {
+        std::string chain;
+        for (std::size_t i = 0; i < stack_.size(); ++i)
+            chain.append(stack_[i]).append(" -> ");
+        return fail(canonical + ": include cycle: " + chain + canonical);
+    }
+
+    if (stack_.size() > limits_.max_include_depth) {
+        std::ostringstream ss;
+        ss << canonical << ": includes nested deeper than "
+           << limits_.max_include_depth;
+        exceeded_ = parser::limits::LIMIT_INCLUDE_DEPTH;
+        return fail(ss.str());
+    }
+
+    stack_.push_back(canonical);
+    if (!replay(canonical, doc))
+        return false;
+    stack_.pop_back();
+    return true;
+}
+
+bool loader::replay(const std::string &path, document &doc) {
+    const parsed_file &f = parse(path);
+    const std::string *name = 0;
+    for (events::const_iterator it = f.evs.begin(); it != f.evs.end();
+         ++it) {
+        switch (it->type) {
+        case parser::EVENT_SECTION:
+            if (!count_entry(path))
+                return false;
+            if (!doc.add_section(it->value))
+                return fail_at(path, doc.error());
+            break;
+        case parser::EVENT_NAME:
+            if (!count_entry(path))
+                return false;
+            name = &it->value;
+            break;
+        case parser::EVENT_VALUE:
+            if (!doc.add_param(*name, it->value))
+                return fail_at(path, doc.error());
+            break;
+        case parser::EVENT_INCLUDE:
+            if (!count_entry(path))
+                return false;
+            if (!include(resolve(path, it->value), doc))
+                return false;
+            break;
+        case parser::EVENT_ERROR:
+            // The message already names this file.
+            exceeded_ = f.exceeded;
+            stack_.pop_back();
+            return fail(it->value);
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+bool loader::fail_at(const std::string &path, const std::string &message) {
+    stack_.pop_back();
+    return fail(path + ": " + message);
+}
+
+/**
+ * Counts an entry added by the current load against the limit.
+ */
+bool loader::count_entry(const std::string &path) {
+    if (++entries_ <= limits_.max_entries)
+        return true;
+    std::ostringstream ss;
+    ss << "more than " << limits_.max_entries << " entries";
+    exceeded_ = parser::limits::LIMIT_ENTRIES;
+    return fail_at(path, ss.str());
+}
+
+bool loader::fail(const std::string &message) {
+    error_ = message;
+    for (std::size_t i = stack_.size(); i > 0; --i)
+        error_.append("\n  included from ").append(stack_[i - 1]);
+    return false;
+}
+}
+}
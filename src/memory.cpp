@@ -0,0 +1,112 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The monotonic resource keeps the header of every upstream
+ * block at its start, so releasing walks the blocks without any side
+ * storage.  Allocations are aligned by rounding the current pointer up;
+ * alignments are assumed to be powers of two.
+ */
+
+#include "config/ini/memory.hpp"
+#include <stdint.h>
+
+namespace config {
+namespace ini {
+
+namespace {
+class new_delete_resource_impl : public memory_resource {
+    void *do_allocate(std::size_t bytes, std::size_t) {
+        return ::operator new(bytes);
+    }
+    void do_deallocate(void *p, std::size_t, std::size_t) {
+        ::operator delete(p);
+    }
+    bool do_is_equal(const memory_resource &other) const {
+        return this == &other;
+    }
+};
+
+const std::size_t first_block_size = 1024;
+
+char *align_up(char *p, std::size_t alignment) {
+    const uintptr_t a = alignment;
+    return reinterpret_cast<char *>(
+        (reinterpret_cast<uintptr_t>(p) + a - 1) & ~(a - 1));
+}
+}
+
+memory_resource *new_delete_resource() {
+    static new_delete_resource_impl r;
+    return &r;
+}
+
+monotonic_buffer_resource::monotonic_buffer_resource(
+    memory_resource *upstream)
+    : upstream_(upstream)
+    , initial_(0)
+    , initial_size_(0)
+    , cur_(0)
+    , end_(0)
+    , next_size_(first_block_size)
+    , blocks_(0)
+{}
+
+monotonic_buffer_resource::monotonic_buffer_resource(
+    void *buffer, std::size_t size, memory_resource *upstream)
+    : upstream_(upstream)
+    , initial_(static_cast<char *>(buffer))
+    , initial_size_(size)
+    , cur_(initial_)
+    , end_(initial_ + size)
+    , next_size_(size > first_block_size ? 2 * size : first_block_size)
+    , blocks_(0)
+{}
+
+monotonic_buffer_resource::~monotonic_buffer_resource() { release(); }
+
+void monotonic_buffer_resource::release() {
+    while (blocks_) {
+        block *next = blocks_->next;
+        upstream_->deallocate(blocks_, blocks_->size);
+        blocks_ = next;
+    }
+    cur_ = initial_;
+    end_ = initial_ + initial_size_;
+}
+
+void *monotonic_buffer_resource::do_allocate(std::size_t bytes,
+                                             std::size_t alignment) {
+    char *p = cur_ ? align_up(cur_, alignment) : 0;
+    if (!p || p > end_ || static_cast<std::size_t>(end_ - p) < bytes) {
+        std::size_t size = next_size_;
+        while (size < sizeof(block) + bytes + alignment)
+            size *= 2;
+        block *b = static_cast<block *>(upstream_->allocate(size));
+        b->next = blocks_;
+        b->size = size;
+        blocks_ = b;
+        next_size_ = 2 * size;
+        end_ = reinterpret_cast<char *>(b) + size;
+        p = align_up(reinterpret_cast<char *>(b + 1), alignment);
+    }
+    cur_ = p + bytes;
+    return p;
+}
+}
+}
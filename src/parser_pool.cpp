@@ -0,0 +1,103 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The mutex only guards the list of idle parsers; parsers are
+ * reset outside of it.
+ */
+
+#include "config/ini/parser_pool.hpp"
+
+namespace config {
+namespace ini {
+
+namespace {
+/**
+ * Locks the mutex for the lifetime of the object.
+ */
+class lock_guard {
+public:
+    explicit lock_guard(pthread_mutex_t &m)
+        : m_(m)
+    {
+        pthread_mutex_lock(&m_);
+    }
+
+    ~lock_guard() { pthread_mutex_unlock(&m_); }
+
+private:
+    pthread_mutex_t &m_;
+};
+}
+
+parser_pool::lease::lease(parser_pool &pool, std::istream &in,
+                          const std::string &filename)
+    : pool_(pool)
+    , parser_(pool.acquire(in, filename))
+{}
+
+parser_pool::lease::~lease() { pool_.release(parser_); }
+
+parser_pool::parser_pool(std::size_t max_idle)
+    : max_idle_(max_idle)
+{
+    pthread_mutex_init(&mutex_, 0);
+}
+
+parser_pool::~parser_pool() {
+    for (std::size_t i = 0; i < idle_.size(); ++i)
+        delete idle_[i];
+    pthread_mutex_destroy(&mutex_);
+}
+
+parser *parser_pool::acquire(std::istream &in, const std::string &filename) {
+    parser *p = 0;
+    {
+        lock_guard lock(mutex_);
+        if (!idle_.empty()) {
+            p = idle_.back();
+            idle_.pop_back();
+        }
+    }
+    if (p) {
+        // Settings survive reset(), the previous holder's must not leak
+        // into this lease.
+        p->reset(in, filename);
+        p->reset_settings();
+        return p;
+    }
+    return new parser(filename, in);
+}
+
+void parser_pool::release(parser *p) {
+    {
+        lock_guard lock(mutex_);
+        if (idle_.size() < max_idle_) {
+            idle_.push_back(p);
+            return;
+        }
+    }
+    delete p;
+}
+
+std::size_t parser_pool::idle() const {
+    lock_guard lock(mutex_);
+    return idle_.size();
+}
+}
+}
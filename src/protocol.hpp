@@ -0,0 +1,102 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#ifndef CONFIG_INI_PROTOCOL_HPP
+#define CONFIG_INI_PROTOCOL_HPP
+
+/**
+ * @file
+ *
+ * @detail Wire format shared by server and client.  Integers are in host
+ * byte order, the socket never leaves the host.
+ *
+ *     frame    := u32 size, body (size bytes)
+ *     request  := u32 id, u8 op, u32 count, item * count
+ *       GET    item := str section, str name
+ *       LIST   item := str section
+ *     response := u32 id, u8 status, u64 generation, u32 count,
+ *                 item * count
+ *       GET    item := u8 found, [str value]
+ *       LIST   item := u8 found, [u32 n, str name * n]
+ *     str      := u32 size, bytes
+ *
+ * Responses are sent in the order of requests, so a client may pipeline
+ * any number of frames.
+ */
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+
+namespace config {
+namespace ini {
+namespace protocol {
+
+enum op { OP_GET = 1, OP_LIST = 2 };
+
+enum status { STATUS_OK = 0, STATUS_BAD_REQUEST = 1 };
+
+/// Frames larger than this are rejected.
+const uint32_t max_frame = 16u << 20;
+
+template <typename T> void put(std::string &out, T v) {
+    out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <typename String>
+void put_str(std::string &out, const String &s) {
+    put(out, static_cast<uint32_t>(s.size()));
+    out.append(s.data(), s.size());
+}
+
+/**
+ * Sequential reader of a frame body; every read fails once the body is
+ * exhausted.
+ */
+class reader {
+public:
+    reader(const char *data, std::size_t size)
+        : cur_(data)
+        , end_(data + size)
+    {}
+
+    template <typename T> bool get(T &v) {
+        if (static_cast<std::size_t>(end_ - cur_) < sizeof(v))
+            return false;
+        std::memcpy(&v, cur_, sizeof(v));
+        cur_ += sizeof(v);
+        return true;
+    }
+
+    bool get_str(std::string &s) {
+        uint32_t size;
+        if (!get(size) || static_cast<std::size_t>(end_ - cur_) < size)
+            return false;
+        s.assign(cur_, size);
+        cur_ += size;
+        return true;
+    }
+
+    bool done() const { return cur_ == end_; }
+
+private:
+    const char *cur_;
+    const char *end_;
+};
+}
+}
+}
+
+#endif
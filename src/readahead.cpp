@@ -0,0 +1,216 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The ring is a single-producer single-consumer queue.  The
+ * producer owns the blocks in [tail_, head_ + 1) modulo the ring size
+ * that it has not published yet, the reader those in [tail_, head_).
+ * Publishing stores a block size and then increments head_ with release
+ * semantics; releasing a block increments tail_.
+ *
+ * Waiting uses futexes on the counters: a side that finds the ring empty
+ * (full) sleeps until head_ (space_) changes.  The producer waits on
+ * space_ rather than on tail_ so that close() can wake it without giving
+ * it a block.  A futex wait returns at once if the word changed after it
+ * was read, so wakeups cannot be lost.
+ *
+ * The wake system call is only made when the other side announced that
+ * it sleeps, so streaming without waits costs no system calls besides
+ * read(2).  The sleeper sets its flag before it reads the word again,
+ * the waker changes the word before it reads the flag, and full fences
+ * separate both pairs: either the waker sees the flag or the sleeper
+ * sees the new word.
+ */
+
+#include "config/ini/readahead.hpp"
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace config {
+namespace ini {
+
+namespace {
+uint32_t load(const uint32_t &v) {
+    return __atomic_load_n(&v, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Sleeps while \p word equals \p expected, announcing it in \p waiting.
+ */
+void wait(uint32_t &word, uint32_t expected, uint32_t &waiting) {
+    __atomic_store_n(&waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&word, __ATOMIC_RELAXED) == expected)
+        ::syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, expected, 0, 0, 0);
+    __atomic_store_n(&waiting, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Wakes the side sleeping on \p word, if \p waiting says there is one.
+ * Must follow the change of the word.
+ */
+void wake(uint32_t &word, uint32_t &waiting) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&waiting, __ATOMIC_RELAXED))
+        ::syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+}
+
+/**
+ * Reads until \p size bytes are read or the file ends.  Returns the
+ * number of bytes read or -1 on error.
+ */
+ssize_t read_full(int fd, char *buf, std::size_t size) {
+    std::size_t n = 0;
+    while (n < size) {
+        const ssize_t r = ::read(fd, buf + n, size - n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        n += r;
+    }
+    return n;
+}
+}
+
+readahead_buf::readahead_buf(std::size_t block_size, std::size_t blocks)
+    : block_size_(block_size)
+    , ring_(block_size * blocks)
+    , sizes_(blocks)
+    , fd_(-1)
+    , head_(0)
+    , tail_(0)
+    , space_(0)
+    , stop_(0)
+    , reader_waits_(0)
+    , producer_waits_(0)
+    , read_errno_(0)
+    , holding_(false)
+{}
+
+readahead_buf::~readahead_buf() { close(); }
+
+bool readahead_buf::open(const std::string &path) {
+    close();
+    error_.clear();
+    path_ = path;
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        error_ = path + ": open: " + std::strerror(errno);
+        return false;
+    }
+    ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    head_ = tail_ = space_ = 0;
+    stop_ = 0;
+    reader_waits_ = producer_waits_ = 0;
+    read_errno_ = 0;
+    holding_ = false;
+    setg(0, 0, 0);
+    const int err = pthread_create(&thread_, 0, &readahead_buf::run, this);
+    if (err != 0) {
+        error_ = path + ": pthread_create: " + std::strerror(err);
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+void readahead_buf::close() {
+    if (fd_ < 0)
+        return;
+    __atomic_store_n(&stop_, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&space_, 1, __ATOMIC_RELEASE);
+    wake(space_, producer_waits_);
+    pthread_join(thread_, 0);
+    ::close(fd_);
+    fd_ = -1;
+    setg(0, 0, 0);
+}
+
+void *readahead_buf::run(void *self) {
+    static_cast<readahead_buf *>(self)->produce();
+    return 0;
+}
+
+void readahead_buf::produce() {
+    const uint32_t blocks = sizes_.size();
+    for (uint32_t head = 0;; ++head) {
+        // Wait for a free block.
+        for (;;) {
+            const uint32_t space = load(space_);
+            if (__atomic_load_n(&stop_, __ATOMIC_ACQUIRE))
+                return;
+            if (head - load(tail_) < blocks)
+                break;
+            wait(space_, space, producer_waits_);
+        }
+        const std::size_t i = head % blocks;
+        const ssize_t n = read_full(fd_, &ring_[i * block_size_],
+                                    block_size_);
+        if (n < 0)
+            read_errno_ = errno;
+        sizes_[i] = n < 0 ? 0 : n;
+        __atomic_store_n(&head_, head + 1, __ATOMIC_RELEASE);
+        wake(head_, reader_waits_);
+        if (n <= 0)
+            return;
+    }
+}
+
+readahead_buf::int_type readahead_buf::underflow() {
+    if (gptr() != egptr())
+        return traits_type::to_int_type(*gptr());
+    if (fd_ < 0)
+        return traits_type::eof();
+    const uint32_t blocks = sizes_.size();
+    if (holding_) {
+        // The end marker is never released.
+        if (sizes_[tail_ % blocks] == 0)
+            return traits_type::eof();
+        __atomic_store_n(&tail_, tail_ + 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&space_, 1, __ATOMIC_RELEASE);
+        wake(space_, producer_waits_);
+        holding_ = false;
+    }
+    for (;;) {
+        const uint32_t head = load(head_);
+        if (head != tail_)
+            break;
+        wait(head_, head, reader_waits_);
+    }
+    holding_ = true;
+    const std::size_t i = tail_ % blocks;
+    if (sizes_[i] == 0) {
+        if (read_errno_)
+            error_ = path_ + ": read: " + std::strerror(read_errno_);
+        return traits_type::eof();
+    }
+    char *block = &ring_[i * block_size_];
+    setg(block, block, block + sizes_[i]);
+    return traits_type::to_int_type(*block);
+}
+}
+}
@@ -0,0 +1,62 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail The state functions are those of parser_machine, which is
+ * instantiated with resource_tokens next to its implementation.
+ */
+
+#include "config/ini/resource_parser.hpp"
+#include "chars.hpp"
+
+namespace config {
+namespace ini {
+
+void resource_tokens::error(event &e, std::size_t line, std::size_t column,
+                            const char *message) const {
+    // Composed piecewise, so that nothing is allocated from the heap.
+    char position[64];
+    chars::bounded_writer w(position, sizeof(position));
+    w << ":" << line << ":" << column << ": ";
+    e.value.assign(filename_);
+    e.value.append(position, w.size());
+    e.value.append(message);
+}
+
+template <typename Dialect>
+basic_resource_parser<Dialect>::basic_resource_parser(memory_resource *r)
+    : machine(0, resource_tokens(std::string(), r))
+{}
+
+template <typename Dialect>
+basic_resource_parser<Dialect>::basic_resource_parser(
+    const std::string &filename, std::istream &in, memory_resource *r)
+    : machine(&in, resource_tokens(filename, r))
+{}
+
+template <typename Dialect>
+void basic_resource_parser<Dialect>::reset(std::istream &in,
+                                           const std::string &filename) {
+    this->tokens_.set_filename(filename);
+    machine::restart(&in);
+}
+
+template class basic_resource_parser<default_dialect>;
+template class basic_resource_parser<relaxed_dialect>;
+}
+}
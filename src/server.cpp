@@ -0,0 +1,420 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail Linux implementation: epoll for readiness, inotify for file
+ * changes and an eventfd to interrupt the loop.  Sockets are non-blocking
+ * and edge triggered; every ready connection is drained, all complete
+ * frames in its input are answered into one output buffer and the buffer
+ * is written with as few system calls as the socket allows.
+ *
+ * Directories rather than files are watched, because files replaced by
+ * rename (see atomic_writer) would otherwise drop their watches.
+ */
+
+#include "config/ini/server.hpp"
+#include "protocol.hpp"
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace config {
+namespace ini {
+
+namespace {
+const uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+                            IN_DELETE | IN_MOVED_FROM;
+
+/// Pending output above which a connection is not read.
+const std::size_t high_water = 1 << 20;
+
+std::string dir_name(const std::string &path) {
+    const std::size_t slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+bool add_fd(int epoll, int fd, uint32_t events) {
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    return ::epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+}
+
+server::server(const std::string &path, const document::options &opts)
+    : path_(path)
+    , doc_(opts)
+    , generation_(0)
+    , epoll_(-1)
+    , listen_(-1)
+    , wakeup_(-1)
+    , inotify_(-1)
+    , stopped_(false)
+{}
+
+server::~server() {
+    while (!connections_.empty())
+        close_connection(connections_.begin()->first);
+    if (listen_ >= 0) {
+        ::close(listen_);
+        ::unlink(socket_path_.c_str());
+    }
+    if (inotify_ >= 0)
+        ::close(inotify_);
+    if (wakeup_ >= 0)
+        ::close(wakeup_);
+    if (epoll_ >= 0)
+        ::close(epoll_);
+}
+
+bool server::listen(const std::string &socket_path) {
+    error_.clear();
+    if (!reload())
+        return false;
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        error_ = socket_path + ": socket path is too long";
+        return false;
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size());
+
+    epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_ < 0)
+        return fail("epoll_create1", socket_path);
+    wakeup_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_ < 0 || !add_fd(epoll_, wakeup_, EPOLLIN))
+        return fail("eventfd", socket_path);
+    inotify_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_ < 0 || !add_fd(epoll_, inotify_, EPOLLIN))
+        return fail("inotify_init1", socket_path);
+    watch();
+
+    listen_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                       0);
+    if (listen_ < 0)
+        return fail("socket", socket_path);
+    ::unlink(socket_path.c_str());
+    if (::bind(listen_, reinterpret_cast<struct sockaddr *>(&addr),
+               sizeof(addr)) != 0)
+        return fail("bind", socket_path);
+    socket_path_ = socket_path;
+    if (::listen(listen_, SOMAXCONN) != 0)
+        return fail("listen", socket_path);
+    if (!add_fd(epoll_, listen_, EPOLLIN))
+        return fail("epoll_ctl", socket_path);
+    return true;
+}
+
+bool server::reload() {
+    document next(doc_.get_options(), doc_.get_resource());
+    loader_.clear_cache();
+    if (!loader_.load(path_, next)) {
+        error_ = loader_.error();
+        return false;
+    }
+    doc_.swap(next);
+    section_params_.assign(doc_.sections().size(),
+                           std::vector<std::size_t>());
+    const document::param_vector &params = doc_.params();
+    for (std::size_t p = 0; p < params.size(); ++p)
+        section_params_[params[p].section].push_back(p);
+    ++generation_;
+    if (inotify_ >= 0)
+        watch();
+    return true;
+}
+
+void server::watch() {
+    std::vector<std::string> files;
+    loader_.files(files);
+    files_.clear();
+    files_.insert(files.begin(), files.end());
+    std::map<int, std::string> watches;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        const std::string dir = dir_name(files[i]);
+        // Watch descriptors are per inode, adding a directory twice
+        // returns the same descriptor.
+        const int wd = ::inotify_add_watch(inotify_, dir.c_str(), watch_mask);
+        if (wd >= 0)
+            watches[wd] = dir;
+    }
+    // Directories of files that are no longer included are dropped.
+    for (std::map<int, std::string>::const_iterator it = watches_.begin();
+         it != watches_.end(); ++it)
+        if (!watches.count(it->first))
+            ::inotify_rm_watch(inotify_, it->first);
+    watches_.swap(watches);
+}
+
+bool server::read_changes() {
+    bool changed = false;
+    char buf[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = ::read(inotify_, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *e =
+                reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + e->len;
+            const std::map<int, std::string>::const_iterator it =
+                watches_.find(e->wd);
+            if (it != watches_.end() && e->len &&
+                files_.count(it->second + "/" + e->name))
+                changed = true;
+        }
+    }
+    return changed;
+}
+
+bool server::run() {
+    __atomic_store_n(&stopped_, false, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&stopped_, __ATOMIC_ACQUIRE))
+        if (!run_once(-1))
+            return false;
+    return true;
+}
+
+void server::stop() {
+    __atomic_store_n(&stopped_, true, __ATOMIC_RELEASE);
+    const uint64_t one = 1;
+    if (wakeup_ >= 0) {
+        const ssize_t r = ::write(wakeup_, &one, sizeof(one));
+        (void)r;
+    }
+}
+
+bool server::run_once(int timeout_ms) {
+    struct epoll_event events[64];
+    const int n = ::epoll_wait(epoll_, events, 64, timeout_ms);
+    if (n < 0)
+        return errno == EINTR ? true : fail("epoll_wait", socket_path_);
+
+    bool changed = false;
+    for (int i = 0; i < n; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == listen_) {
+            accept_all();
+        } else if (fd == wakeup_) {
+            uint64_t v;
+            const ssize_t r = ::read(wakeup_, &v, sizeof(v));
+            (void)r;
+        } else if (fd == inotify_) {
+            changed = read_changes() || changed;
+        } else {
+            handle(fd);
+        }
+    }
+    // A failed reload keeps serving the previous document.
+    if (changed)
+        reload();
+    return true;
+}
+
+void server::accept_all() {
+    for (;;) {
+        const int fd = ::accept4(listen_, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        if (!add_fd(epoll_, fd, EPOLLIN | EPOLLRDHUP | EPOLLET)) {
+            ::close(fd);
+            continue;
+        }
+        connection &c = connections_[fd];
+        c.writing = false;
+        c.paused = false;
+        c.eof = false;
+    }
+}
+
+void server::handle(int fd) {
+    const std::map<int, connection>::iterator it = connections_.find(fd);
+    if (it == connections_.end())
+        return;
+    connection &c = it->second;
+
+    // Sockets are edge triggered, so a connection paused with unread
+    // input is resumed here once its output drains.
+    for (;;) {
+        if (!serve(fd, c) || !flush(fd, c)) {
+            close_connection(fd);
+            return;
+        }
+        if (!c.paused || c.out.size() >= high_water)
+            break;
+    }
+    // Requests sent before the peer shut down its side are still
+    // answered.
+    if (c.eof && c.out.empty())
+        close_connection(fd);
+}
+
+/**
+ * Answers complete frames and reads more input until the socket is
+ * drained or the output reaches the high-water mark.  Returns false if
+ * the connection must be closed.
+ */
+bool server::serve(int fd, connection &c) {
+    std::size_t pos = 0;
+    for (;;) {
+        while (c.out.size() < high_water &&
+               c.in.size() - pos >= sizeof(uint32_t)) {
+            uint32_t size;
+            std::memcpy(&size, c.in.data() + pos, sizeof(size));
+            if (size > protocol::max_frame)
+                return false;
+            if (c.in.size() - pos - sizeof(size) < size)
+                break;
+            if (!handle_frame(c.in.data() + pos + sizeof(size), size,
+                              c.out))
+                return false;
+            pos += sizeof(size) + size;
+        }
+        c.in.erase(0, pos);
+        pos = 0;
+        c.paused = c.out.size() >= high_water;
+        if (c.paused || c.eof)
+            return true;
+
+        char buf[65536];
+        const ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n > 0) {
+            c.in.append(buf, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            return false;
+        c.eof = n == 0;
+        return true;
+    }
+}
+
+bool server::handle_frame(const char *body, std::size_t size,
+                          std::string &out) {
+    protocol::reader r(body, size);
+    uint32_t id, count;
+    uint8_t op;
+    if (!r.get(id) || !r.get(op) || !r.get(count))
+        return false;
+
+    const std::size_t start = out.size();
+    protocol::put(out, uint32_t(0));
+    protocol::put(out, id);
+    protocol::put(out, uint8_t(protocol::STATUS_OK));
+    protocol::put(out, generation_);
+    protocol::put(out, count);
+
+    std::string section, name;
+    bool ok = op == protocol::OP_GET || op == protocol::OP_LIST;
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        if (op == protocol::OP_GET) {
+            ok = r.get_str(section) && r.get_str(name);
+            if (!ok)
+                break;
+            const string *value = doc_.get(section, name);
+            protocol::put(out, uint8_t(value != 0));
+            if (value)
+                protocol::put_str(out, *value);
+        } else {
+            ok = r.get_str(section);
+            if (!ok)
+                break;
+            const std::size_t s = doc_.find_section(section);
+            protocol::put(out, uint8_t(s != document::npos));
+            if (s == document::npos)
+                continue;
+            const document::param_vector &params = doc_.params();
+            const std::vector<std::size_t> &names = section_params_[s];
+            protocol::put(out, static_cast<uint32_t>(names.size()));
+            for (std::size_t p = 0; p < names.size(); ++p)
+                protocol::put_str(out, params[names[p]].name);
+        }
+    }
+    if (!ok || !r.done()) {
+        // Answer malformed requests with an empty response.
+        out.resize(start);
+        protocol::put(out, uint32_t(0));
+        protocol::put(out, id);
+        protocol::put(out, uint8_t(protocol::STATUS_BAD_REQUEST));
+        protocol::put(out, generation_);
+        protocol::put(out, uint32_t(0));
+    }
+    const uint32_t body_size = out.size() - start - sizeof(uint32_t);
+    std::memcpy(&out[start], &body_size, sizeof(body_size));
+    return true;
+}
+
+bool server::flush(int fd, connection &c) {
+    std::size_t pos = 0;
+    while (pos < c.out.size()) {
+        const ssize_t n = ::send(fd, c.out.data() + pos, c.out.size() - pos,
+                                 MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+            break;
+        }
+        pos += n;
+    }
+    c.out.erase(0, pos);
+
+    // Wait for the socket to become writable only while output is
+    // pending.
+    const bool writing = !c.out.empty();
+    if (writing != c.writing) {
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        if (writing)
+            ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &ev) != 0)
+            return false;
+        c.writing = writing;
+    }
+    return true;
+}
+
+void server::close_connection(int fd) {
+    ::epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, 0);
+    ::close(fd);
+    connections_.erase(fd);
+}
+
+bool server::fail(const char *what, const std::string &name) {
+    error_ = name + ": " + what + ": " + std::strerror(errno);
+    return false;
+}
+}
+}
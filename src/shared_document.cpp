@@ -0,0 +1,479 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail A published image is laid out as a header followed by the
+ * section table, the parameter table, the value table, the hash slots
+ * and the string pool.  All references are 32-bit offsets relative to
+ * the pool, so the image can be mapped at any address.  Parameters are
+ * hashed by section and name together; the slots hold parameter indices
+ * plus one and use linear probing.
+ *
+ * The control object is a sequence lock: the publisher makes the
+ * sequence odd, stores the generation and the image size and makes the
+ * sequence even again.  Readers retry while the sequence is odd or has
+ * changed under them.  Images are immutable once the control object
+ * refers to them, so lookups need no synchronization.
+ */
+
+#include "config/ini/shared_document.hpp"
+#include "config/ini/document.hpp"
+#include "hash.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace config {
+namespace ini {
+
+namespace {
+const uint32_t control_magic = 0x43494e43;  // "CNIC"
+const uint32_t image_magic = 0x43494e49;    // "INIC"
+const uint32_t image_version = 1;
+const uint32_t flag_case_insensitive = 1;
+/// Reads of the control block before refresh() gives up.
+const int max_refresh_attempts = 100;
+
+struct control_block {
+    uint32_t magic;
+    uint32_t seq;
+    uint64_t generation;
+    uint64_t size;
+};
+
+struct image_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t section_count;
+    uint32_t param_count;
+    uint32_t value_count;
+    uint32_t slot_count;
+    uint32_t pool_size;
+};
+
+struct string_entry {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct param_entry {
+    uint32_t section;
+    string_entry name;
+    uint32_t first;
+    uint32_t count;
+    uint32_t hash;
+};
+
+/**
+ * Pointers to the tables of a mapped image.
+ */
+struct image_view {
+    const image_header *header;
+    const string_entry *sections;
+    const param_entry *params;
+    const string_entry *values;
+    const uint32_t *slots;
+    const char *pool;
+};
+
+std::size_t image_size(const image_header &h) {
+    return sizeof(image_header) + h.section_count * sizeof(string_entry) +
+           h.param_count * sizeof(param_entry) +
+           h.value_count * sizeof(string_entry) +
+           h.slot_count * sizeof(uint32_t) + h.pool_size;
+}
+
+image_view view(const char *image) {
+    image_view v;
+    v.header = reinterpret_cast<const image_header *>(image);
+    v.sections = reinterpret_cast<const string_entry *>(v.header + 1);
+    v.params = reinterpret_cast<const param_entry *>(
+        v.sections + v.header->section_count);
+    v.values = reinterpret_cast<const string_entry *>(
+        v.params + v.header->param_count);
+    v.slots = reinterpret_cast<const uint32_t *>(
+        v.values + v.header->value_count);
+    v.pool = reinterpret_cast<const char *>(v.slots + v.header->slot_count);
+    return v;
+}
+
+/**
+ * Appends \p s to the pool, returns false if the pool overflows 32-bit
+ * offsets.
+ */
+bool add_string(std::string &pool, const string &s, string_entry &e) {
+    if (pool.size() + s.size() > 0xffffffffu)
+        return false;
+    e.offset = static_cast<uint32_t>(pool.size());
+    e.size = static_cast<uint32_t>(s.size());
+    pool.append(s.data(), s.size());
+    return true;
+}
+
+bool compile(const document &doc, std::vector<char> &image) {
+    const document::string_vector &sections = doc.sections();
+    const document::param_vector &params = doc.params();
+    const bool fold = doc.get_options().case_insensitive;
+
+    std::string pool;
+    std::vector<string_entry> section_entries(sections.size());
+    for (std::size_t i = 0; i < sections.size(); ++i)
+        if (!add_string(pool, sections[i], section_entries[i]))
+            return false;
+
+    std::vector<param_entry> param_entries(params.size());
+    std::vector<string_entry> value_entries;
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        const document::param &p = params[i];
+        param_entry &e = param_entries[i];
+        e.section = static_cast<uint32_t>(p.section);
+        if (!add_string(pool, p.name, e.name))
+            return false;
+        e.first = static_cast<uint32_t>(value_entries.size());
+        e.count = static_cast<uint32_t>(p.count);
+        e.hash = hash::key_hash(sections[p.section], p.name, fold);
+        const document::value_range values = doc.values(p);
+        for (const string *v = values.begin(); v != values.end(); ++v) {
+            string_entry ve;
+            if (!add_string(pool, *v, ve))
+                return false;
+            value_entries.push_back(ve);
+        }
+    }
+
+    uint32_t slot_count = 16;
+    while (slot_count < 2 * params.size())
+        slot_count *= 2;
+    std::vector<uint32_t> slots(slot_count);
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        uint32_t s = param_entries[i].hash & (slot_count - 1);
+        while (slots[s])
+            s = (s + 1) & (slot_count - 1);
+        slots[s] = static_cast<uint32_t>(i + 1);
+    }
+
+    image_header h;
+    h.magic = image_magic;
+    h.version = image_version;
+    h.flags = fold ? flag_case_insensitive : 0;
+    h.section_count = static_cast<uint32_t>(section_entries.size());
+    h.param_count = static_cast<uint32_t>(param_entries.size());
+    h.value_count = static_cast<uint32_t>(value_entries.size());
+    h.slot_count = slot_count;
+    h.pool_size = static_cast<uint32_t>(pool.size());
+
+    image.resize(image_size(h));
+    char *out = &image[0];
+    std::memcpy(out, &h, sizeof(h));
+    out += sizeof(h);
+    if (!section_entries.empty()) {
+        std::memcpy(out, &section_entries[0],
+                    section_entries.size() * sizeof(string_entry));
+        out += section_entries.size() * sizeof(string_entry);
+    }
+    if (!param_entries.empty()) {
+        std::memcpy(out, &param_entries[0],
+                    param_entries.size() * sizeof(param_entry));
+        out += param_entries.size() * sizeof(param_entry);
+    }
+    if (!value_entries.empty()) {
+        std::memcpy(out, &value_entries[0],
+                    value_entries.size() * sizeof(string_entry));
+        out += value_entries.size() * sizeof(string_entry);
+    }
+    std::memcpy(out, &slots[0], slots.size() * sizeof(uint32_t));
+    out += slots.size() * sizeof(uint32_t);
+    std::memcpy(out, pool.data(), pool.size());
+    return true;
+}
+
+std::string image_name(const std::string &name, uint64_t generation) {
+    std::ostringstream ss;
+    ss << name << '.' << generation;
+    return ss.str();
+}
+}
+
+shared_publisher::shared_publisher(const std::string &name)
+    : name_(name)
+    , control_(0)
+    , generation_(0)
+{}
+
+shared_publisher::~shared_publisher() {
+    if (control_)
+        ::munmap(control_, sizeof(control_block));
+}
+
+bool shared_publisher::map_control() {
+    const int fd = ::shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return fail("shm_open", name_);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        (static_cast<std::size_t>(st.st_size) < sizeof(control_block) &&
+         ::ftruncate(fd, sizeof(control_block)) != 0)) {
+        const bool r = fail("ftruncate", name_);
+        ::close(fd);
+        return r;
+    }
+    void *p = ::mmap(0, sizeof(control_block), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return fail("mmap", name_);
+    control_ = p;
+    control_block *c = static_cast<control_block *>(control_);
+    if (c->magic != control_magic) {
+        std::memset(c, 0, sizeof(*c));
+        c->magic = control_magic;
+    }
+    // Continue the numbering of a previous publisher.
+    if (c->generation > generation_)
+        generation_ = c->generation;
+    return true;
+}
+
+bool shared_publisher::publish(const document &doc) {
+    error_.clear();
+    std::vector<char> image;
+    if (!compile(doc, image)) {
+        error_ = name_ + ": document is too large";
+        return false;
+    }
+    if (!control_ && !map_control())
+        return false;
+
+    const uint64_t next = generation_ + 1;
+    const std::string path = image_name(name_, next);
+    int fd = ::shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        // Leftover of a publisher that died before switching to it.
+        ::shm_unlink(path.c_str());
+        fd = ::shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0)
+        return fail("shm_open", path);
+    if (::ftruncate(fd, image.size()) != 0) {
+        const bool r = fail("ftruncate", path);
+        ::close(fd);
+        ::shm_unlink(path.c_str());
+        return r;
+    }
+    void *p = ::mmap(0, image.size(), PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        const bool r = fail("mmap", path);
+        ::shm_unlink(path.c_str());
+        return r;
+    }
+    std::memcpy(p, &image[0], image.size());
+    ::munmap(p, image.size());
+
+    control_block *c = static_cast<control_block *>(control_);
+    const uint32_t seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&c->generation, next, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->size, static_cast<uint64_t>(image.size()),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&c->seq, seq + 2, __ATOMIC_RELEASE);
+
+    if (generation_)
+        ::shm_unlink(image_name(name_, generation_).c_str());
+    generation_ = next;
+    return true;
+}
+
+void shared_publisher::remove() {
+    if (generation_)
+        ::shm_unlink(image_name(name_, generation_).c_str());
+    ::shm_unlink(name_.c_str());
+    if (control_) {
+        ::munmap(control_, sizeof(control_block));
+        control_ = 0;
+    }
+    generation_ = 0;
+}
+
+bool shared_publisher::fail(const char *what, const std::string &name) {
+    error_ = name + ": " + what + ": " + std::strerror(errno);
+    return false;
+}
+
+shared_document::shared_document(const std::string &name)
+    : name_(name)
+    , control_(0)
+    , image_(0)
+    , image_size_(0)
+    , generation_(0)
+{}
+
+shared_document::~shared_document() {
+    unmap_image();
+    if (control_)
+        ::munmap(const_cast<void *>(control_), sizeof(control_block));
+}
+
+bool shared_document::map_control() {
+    const int fd = ::shm_open(name_.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return fail("shm_open", name_);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(control_block)) {
+        ::close(fd);
+        error_ = name_ + ": nothing is published";
+        return false;
+    }
+    void *p = ::mmap(0, sizeof(control_block), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return fail("mmap", name_);
+    control_ = p;
+    return true;
+}
+
+bool shared_document::refresh() {
+    error_.clear();
+    if (!control_ && !map_control())
+        return false;
+
+    const control_block *c = static_cast<const control_block *>(control_);
+    // A generation may be unlinked between reading the control block and
+    // opening it; a newer one is then already published.
+    for (int attempt = 0; attempt < max_refresh_attempts; ++attempt) {
+        // Let a publisher in the middle of an update finish it.
+        if (attempt)
+            sched_yield();
+        const uint32_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+        const uint64_t generation =
+            __atomic_load_n(&c->generation, __ATOMIC_RELAXED);
+        const uint64_t size = __atomic_load_n(&c->size, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((seq & 1) || seq != __atomic_load_n(&c->seq, __ATOMIC_RELAXED))
+            continue;
+        if (c->magic != control_magic || generation == 0) {
+            error_ = name_ + ": nothing is published";
+            return false;
+        }
+        if (generation == generation_)
+            return true;
+        if (map_image(generation, size))
+            return true;
+        if (errno != ENOENT)
+            return false;
+    }
+    error_ = name_ + ": publisher busy, no stable generation to map";
+    return false;
+}
+
+bool shared_document::map_image(uint64_t generation, uint64_t size) {
+    const std::string path = image_name(name_, generation);
+    const int fd = ::shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return fail("shm_open", path);
+    void *p = ::mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return fail("mmap", path);
+
+    const image_header *h = static_cast<const image_header *>(p);
+    if (size < sizeof(image_header) || h->magic != image_magic ||
+        h->version != image_version || image_size(*h) > size) {
+        ::munmap(p, size);
+        errno = EINVAL;
+        error_ = path + ": invalid image";
+        return false;
+    }
+    unmap_image();
+    image_ = static_cast<const char *>(p);
+    image_size_ = size;
+    generation_ = generation;
+    return true;
+}
+
+void shared_document::unmap_image() {
+    if (image_)
+        ::munmap(const_cast<char *>(image_), image_size_);
+    image_ = 0;
+    image_size_ = 0;
+    generation_ = 0;
+}
+
+const void *shared_document::find(const std::string &section,
+                                  const std::string &name) const {
+    if (!image_)
+        return 0;
+    const image_view v = view(image_);
+    const bool fold = v.header->flags & flag_case_insensitive;
+    const uint32_t h = hash::key_hash(section, name, fold);
+    const uint32_t mask = v.header->slot_count - 1;
+    for (uint32_t s = h & mask; v.slots[s]; s = (s + 1) & mask) {
+        const param_entry &p = v.params[v.slots[s] - 1];
+        if (p.hash != h)
+            continue;
+        const string_entry &sec = v.sections[p.section];
+        if (hash::equal(v.pool + p.name.offset, p.name.size, name, fold) &&
+            hash::equal(v.pool + sec.offset, sec.size, section, fold))
+            return &p;
+    }
+    return 0;
+}
+
+bool shared_document::get(const std::string &section, const std::string &name,
+                          std::string &value) const {
+    const param_entry *p = static_cast<const param_entry *>(
+        find(section, name));
+    if (!p || !p->count)
+        return false;
+    const image_view v = view(image_);
+    const string_entry &e = v.values[p->first + p->count - 1];
+    value.assign(v.pool + e.offset, e.size);
+    return true;
+}
+
+std::size_t shared_document::get_all(const std::string &section,
+                                     const std::string &name,
+                                     std::vector<std::string> &values) const {
+    const param_entry *p = static_cast<const param_entry *>(
+        find(section, name));
+    if (!p)
+        return 0;
+    const image_view v = view(image_);
+    for (uint32_t i = 0; i < p->count; ++i) {
+        const string_entry &e = v.values[p->first + i];
+        values.push_back(std::string(v.pool + e.offset, e.size));
+    }
+    return p->count;
+}
+
+bool shared_document::fail(const char *what, const std::string &name) {
+    error_ = name + ": " + what + ": " + std::strerror(errno);
+    return false;
+}
+}
+}
@@ -0,0 +1,88 @@
+#include "config/ini/atomic_writer.hpp"
+#include "config/ini/editable_document.hpp"
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <sstream>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using config::ini::atomic_writer;
+using config::ini::editable_document;
+
+namespace {
+std::string read_file(const std::string &path) {
+    std::ifstream in(path.c_str());
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+std::size_t count_entries(const std::string &dir) {
+    std::size_t n = 0;
+    DIR *d = opendir(dir.c_str());
+    while (struct dirent *e = readdir(d))
+        if (e->d_name[0] != '.')
+            ++n;
+    closedir(d);
+    return n;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_atomic_writer_replaces_file) {
+    char tmpl[] = "/tmp/config-ini-test.XXXXXX";
+    const std::string dir(mkdtemp(tmpl));
+    const std::string path = dir + "/app.ini";
+
+    atomic_writer w(path);
+    w.set_buffer_size(4);
+    BOOST_REQUIRE(w.write(std::string("[a]\nx = 1\n")));
+    BOOST_CHECK(read_file(path) == "[a]\nx = 1\n");
+    BOOST_CHECK(w.last_timings().total_ns >= w.last_timings().fsync_ns);
+
+    std::istringstream is(read_file(path));
+    editable_document doc;
+    BOOST_REQUIRE(doc.load(is));
+    doc.set("a", "x", "2");
+    BOOST_REQUIRE(w.write(doc));
+    BOOST_CHECK(read_file(path) == "[a]\nx = 2\n");
+    BOOST_CHECK(count_entries(dir) == 1);
+
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_atomic_writer_reports_errors) {
+    atomic_writer w("/nonexistent-dir/app.ini");
+    BOOST_CHECK(!w.write(std::string("x = 1\n")));
+    BOOST_CHECK(w.error().find("/nonexistent-dir/app.ini.tmp.") == 0);
+    BOOST_CHECK(w.error().find(": open: ") != std::string::npos);
+    BOOST_CHECK(!w.replaced());
+}
+
+BOOST_AUTO_TEST_CASE(test_atomic_writer_file_mode) {
+    char tmpl[] = "/tmp/config-ini-test.XXXXXX";
+    const std::string dir(mkdtemp(tmpl));
+    const std::string path = dir + "/app.ini";
+    struct stat st;
+
+    // New files get 0666 minus the umask.
+    const mode_t mask = umask(027);
+    atomic_writer w(path);
+    BOOST_REQUIRE(w.write(std::string("x = 1\n")));
+    BOOST_CHECK(w.replaced());
+    BOOST_REQUIRE(stat(path.c_str(), &st) == 0);
+    BOOST_CHECK((st.st_mode & 07777) == 0640);
+    umask(mask);
+
+    // Replaced files keep their mode.
+    chmod(path.c_str(), 0604);
+    BOOST_REQUIRE(w.write(std::string("x = 2\n")));
+    BOOST_REQUIRE(stat(path.c_str(), &st) == 0);
+    BOOST_CHECK((st.st_mode & 07777) == 0604);
+
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+}
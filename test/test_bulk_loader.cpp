@@ -0,0 +1,135 @@
+#include "config/ini/bulk_loader.hpp"
+#include "config/ini/document.hpp"
+#include "test_helpers.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using config::ini::bulk_loader;
+using config::ini::document;
+using config::ini::parser;
+
+namespace {
+/**
+ * Writes \p count files, the i-th with i params, and a few broken ones.
+ */
+std::vector<std::string> make_files(temp_dir &dir, std::size_t count) {
+    std::vector<std::string> paths;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::ostringstream name, content;
+        name << "file" << i << ".ini";
+        content << "[file " << i << "]\n";
+        for (std::size_t j = 0; j < i; ++j)
+            content << "param" << j << " = value " << j << "\n";
+        paths.push_back(dir.write(name.str(), content.str()));
+    }
+    paths.push_back(dir.path + "/missing.ini");
+    paths.push_back(dir.path);
+    paths.push_back(dir.write("broken.ini", "[broken\n"));
+    paths.push_back(dir.write("empty.ini", ""));
+    return paths;
+}
+
+void check_load(bulk_loader &l, const std::vector<std::string> &paths,
+                std::size_t count) {
+    std::vector<document *> docs;
+    for (std::size_t i = 0; i < paths.size(); ++i)
+        docs.push_back(new document());
+    std::vector<std::string> errors;
+    BOOST_CHECK(!l.load(paths, docs, errors));
+    BOOST_REQUIRE(errors.size() == paths.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        BOOST_CHECK(errors[i].empty());
+        std::ostringstream section, name, value;
+        section << "file " << i;
+        name << "param" << i - 1;
+        value << "value " << i - 1;
+        const document::value_range r =
+            docs[i]->get_all(section.str(), name.str());
+        BOOST_CHECK(i == 0 ? r.empty() : *r.first == value.str().c_str());
+    }
+    BOOST_CHECK(errors[count].find("missing.ini: open:") !=
+                std::string::npos);
+    BOOST_CHECK(errors[count + 1].find(": read:") != std::string::npos);
+    BOOST_CHECK(errors[count + 2].find("broken.ini:1:") !=
+                std::string::npos);
+    BOOST_CHECK(errors[count + 3].empty());
+    for (std::size_t i = 0; i < docs.size(); ++i)
+        delete docs[i];
+}
+
+/**
+ * Counts files passed to the handler.
+ */
+struct counting_handler : bulk_loader::handler {
+    explicit counting_handler(std::size_t n)
+        : events(n)
+        , failed(n)
+    {}
+
+    void parse(std::size_t index, const std::string &, parser &p) {
+        parser::event e;
+        while (p.advance(e))
+            ++events[index];
+    }
+
+    void fail(std::size_t index, const std::string &, const std::string &) {
+        ++failed[index];
+    }
+
+    std::vector<std::size_t> events;
+    std::vector<std::size_t> failed;
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_loader_threads) {
+    temp_dir dir;
+    const std::size_t count = 100;
+    const std::vector<std::string> paths = make_files(dir, count);
+    bulk_loader l(3, 8);
+    l.set_engine(bulk_loader::ENGINE_THREADS);
+    check_load(l, paths, count);
+    BOOST_CHECK(l.used_engine() == bulk_loader::ENGINE_THREADS);
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_loader_io_uring) {
+    if (!bulk_loader::io_uring_available()) {
+        BOOST_TEST_MESSAGE("io_uring is not available, skipping");
+        return;
+    }
+    temp_dir dir;
+    const std::size_t count = 100;
+    const std::vector<std::string> paths = make_files(dir, count);
+    bulk_loader l(2, 5);
+    l.set_engine(bulk_loader::ENGINE_IO_URING);
+    check_load(l, paths, count);
+    BOOST_CHECK(l.used_engine() == bulk_loader::ENGINE_IO_URING);
+    BOOST_CHECK(l.error().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_loader_handler) {
+    temp_dir dir;
+    const std::size_t count = 50;
+    std::vector<std::string> paths = make_files(dir, count);
+    // The same file may be listed more than once.
+    paths.push_back(paths[10]);
+    const bulk_loader::engine engines[] = {bulk_loader::ENGINE_AUTO,
+                                           bulk_loader::ENGINE_THREADS};
+    for (std::size_t k = 0; k < 2; ++k) {
+        bulk_loader l(4, 16);
+        l.set_engine(engines[k]);
+        counting_handler h(paths.size());
+        BOOST_REQUIRE(l.run(paths, h));
+        for (std::size_t i = 0; i < count; ++i) {
+            // A section and a name and a value per param.
+            BOOST_CHECK(h.events[i] == 1 + 2 * i);
+            BOOST_CHECK(h.failed[i] == 0);
+        }
+        BOOST_CHECK(h.failed[count] == 1 && h.failed[count + 1] == 1);
+        BOOST_CHECK(h.failed[count + 2] == 0);
+        BOOST_CHECK(h.events.back() == 21);
+    }
+
+    bulk_loader l;
+    counting_handler h(0);
+    BOOST_CHECK(l.run(std::vector<std::string>(), h));
+}
@@ -0,0 +1,267 @@
+#include "config/ini/document.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using config::ini::document;
+using config::ini::memory_resource;
+using config::ini::monotonic_buffer_resource;
+using config::ini::new_delete_resource;
+
+namespace {
+/**
+ * Counts allocations passed on to the global heap.
+ */
+class counting_resource : public memory_resource {
+public:
+    counting_resource() : allocations(0), live(0) {}
+
+    std::size_t allocations;
+    std::size_t live;
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) {
+        ++allocations;
+        ++live;
+        return new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) {
+        --live;
+        new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const memory_resource &other) const {
+        return this == &other;
+    }
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_document_lookup) {
+    document doc;
+    doc.add_param("top", "0");
+    doc.add_section("a");
+    doc.add_param("x", "1");
+    doc.add_section("b");
+    doc.add_param("x", "2");
+    doc.add_section("a");
+    doc.add_param("x", "3");
+
+    BOOST_CHECK(*doc.get("", "top") == "0");
+    BOOST_CHECK(*doc.get("a", "x") == "3");
+    BOOST_CHECK(*doc.get("b", "x") == "2");
+    BOOST_CHECK(!doc.get("A", "x"));
+    BOOST_CHECK(!doc.get("a", "y"));
+    BOOST_CHECK(doc.sections().size() == 3);
+    BOOST_CHECK(doc.params().size() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_document_many_names) {
+    document doc;
+    for (std::size_t s = 0; s < 100; ++s) {
+        std::ostringstream section;
+        section << "section " << s;
+        doc.add_section(section.str());
+        for (std::size_t p = 0; p < 100; ++p) {
+            std::ostringstream name;
+            name << "a rather long parameter name " << p;
+            doc.add_param(name.str(), section.str());
+        }
+    }
+    BOOST_CHECK(doc.find_section("section 42") == 42);
+    BOOST_REQUIRE(doc.get("section 42", "a rather long parameter name 99"));
+    BOOST_CHECK(*doc.get("section 42", "a rather long parameter name 99") ==
+                "section 42");
+    BOOST_CHECK(!doc.get("section 42", "a rather long parameter name 100"));
+}
+
+BOOST_AUTO_TEST_CASE(test_document_case_insensitive) {
+    document::options opts;
+    opts.case_insensitive = true;
+    document doc(opts);
+    doc.add_section("Database");
+    doc.add_param("Host_Name", "db1");
+    doc.add_section("DATABASE");
+    doc.add_param("port", "5432");
+    doc.add_section("\xD0\x91");
+    doc.add_param("k", "v");
+
+    BOOST_CHECK(doc.sections().size() == 2);
+    BOOST_CHECK(doc.sections()[0] == "Database");
+    BOOST_CHECK(*doc.get("database", "host_name") == "db1");
+    BOOST_CHECK(*doc.get("dAtAbAsE", "PORT") == "5432");
+    BOOST_CHECK(!doc.get("database", "host-name"));
+    // Only ASCII letters are folded.
+    BOOST_CHECK(!doc.get("\xD0\xB1", "k"));
+}
+
+BOOST_AUTO_TEST_CASE(test_document_subtree) {
+    document doc;
+    doc.add_section("service.db.primary");
+    doc.add_section("service.web");
+    doc.add_section("service.db");
+    doc.add_section("service.db-backup");
+    doc.add_section("service.db.replica");
+    doc.add_section("other");
+
+    std::vector<std::size_t> found;
+    BOOST_CHECK(doc.subtree("service.db", found) == 3);
+    BOOST_REQUIRE(found.size() == 3);
+    BOOST_CHECK(doc.sections()[found[0]] == "service.db");
+    BOOST_CHECK(doc.sections()[found[1]] == "service.db.primary");
+    BOOST_CHECK(doc.sections()[found[2]] == "service.db.replica");
+
+    found.clear();
+    BOOST_CHECK(doc.subtree("service", found) == 5);
+    BOOST_CHECK(doc.subtree("", found) == 6);
+    BOOST_CHECK(doc.subtree("service.d", found) == 0);
+    BOOST_CHECK(doc.subtree("missing.path", found) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_document_lists) {
+    document doc;
+    doc.add_section("acl");
+    doc.add_param("allow[]", "10.0.0.1");
+    doc.add_param("deny", "all");
+    doc.add_param("allow []", "10.0.0.2");
+    doc.add_param("deny", "none");
+    for (std::size_t i = 0; i < 1000; ++i) {
+        std::ostringstream value;
+        value << "host" << i;
+        doc.add_param("hosts[]", value.str());
+        doc.add_param("allow[]", value.str());
+    }
+
+    document::value_range allow = doc.get_all("acl", "allow");
+    BOOST_REQUIRE(allow.size() == 1002);
+    BOOST_CHECK(allow.first[0] == "10.0.0.1");
+    BOOST_CHECK(allow.first[1] == "10.0.0.2");
+    BOOST_CHECK(allow.first[1001] == "host999");
+    BOOST_CHECK(*doc.get("acl", "allow") == "host999");
+    BOOST_CHECK(doc.get_all("acl", "hosts").size() == 1000);
+    BOOST_CHECK(doc.get_all("acl", "deny").size() == 1);
+    BOOST_CHECK(*doc.get("acl", "deny") == "none");
+    BOOST_CHECK(doc.get_all("acl", "missing").empty());
+    BOOST_CHECK(doc.params().size() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_document_merge_repeated_params) {
+    document::options opts;
+    opts.duplicate_params = document::DUPLICATE_MERGE;
+    document doc(opts);
+    doc.add_section("s");
+    doc.add_param("k", "1");
+    doc.add_param("other", "x");
+    doc.add_param("k", "2");
+
+    const document::value_range k = doc.get_all("s", "k");
+    BOOST_REQUIRE(k.size() == 2);
+    BOOST_CHECK(*k.begin() == "1" && *(k.end() - 1) == "2");
+}
+
+BOOST_AUTO_TEST_CASE(test_document_duplicate_policies) {
+    document::options opts;
+    opts.duplicate_params = document::DUPLICATE_ERROR;
+    document strict(opts);
+    BOOST_CHECK(strict.add_section("s"));
+    BOOST_CHECK(strict.add_param("k", "1"));
+    BOOST_CHECK(strict.add_param("list[]", "1"));
+    BOOST_CHECK(strict.add_param("list[]", "2"));
+    BOOST_CHECK(!strict.add_param("k", "2"));
+    BOOST_CHECK(strict.error() == "duplicate parameter 'k' in section [s]");
+
+    opts.duplicate_params = document::DUPLICATE_FIRST;
+    opts.duplicate_sections = document::DUPLICATE_FIRST;
+    document first(opts);
+    first.add_section("a");
+    first.add_param("k", "1");
+    first.add_param("k", "2");
+    first.add_section("a");
+    first.add_param("other", "3");
+    BOOST_CHECK(*first.get("a", "k") == "1");
+    BOOST_CHECK(!first.get("a", "other"));
+
+    opts.duplicate_params = document::DUPLICATE_LAST;
+    opts.duplicate_sections = document::DUPLICATE_LAST;
+    document last(opts);
+    last.add_section("a");
+    last.add_param("k", "1");
+    last.add_section("b");
+    last.add_param("k", "2");
+    last.add_section("a");
+    last.add_param("other", "3");
+    BOOST_CHECK(!last.get("a", "k"));
+    BOOST_CHECK(*last.get("a", "other") == "3");
+    BOOST_CHECK(*last.get("b", "k") == "2");
+
+    opts.duplicate_sections = document::DUPLICATE_ERROR;
+    document unique(opts);
+    BOOST_CHECK(unique.add_section("a"));
+    BOOST_CHECK(!unique.add_section("a"));
+    BOOST_CHECK(unique.error() == "duplicate section [a]");
+}
+
+BOOST_AUTO_TEST_CASE(test_document_memory_resource) {
+    counting_resource upstream;
+    {
+        monotonic_buffer_resource arena(&upstream);
+        document doc(document::options(), &arena);
+        BOOST_CHECK(doc.get_resource() == &arena);
+        for (std::size_t s = 0; s < 50; ++s) {
+            std::ostringstream section;
+            section << "service.section number " << s;
+            doc.add_section(section.str());
+            for (std::size_t p = 0; p < 10; ++p) {
+                std::ostringstream name;
+                name << "a rather long parameter name " << p;
+                doc.add_param(name.str(), "a value too long for SSO");
+                doc.add_param("list[]", "another long value to append");
+            }
+        }
+        BOOST_CHECK(*doc.get("service.section number 7",
+                             "a rather long parameter name 3") ==
+                    "a value too long for SSO");
+        BOOST_CHECK(doc.get_all("service.section number 7", "list").size() ==
+                    10);
+        std::vector<std::size_t> nested;
+        BOOST_CHECK(doc.subtree("service", nested) == 50);
+        // Every string and table lives in a few doubling blocks.
+        BOOST_CHECK(upstream.allocations > 0);
+        BOOST_CHECK(upstream.allocations < 16);
+        BOOST_CHECK(doc.params()[42].name.get_allocator().resource() ==
+                    &arena);
+        BOOST_CHECK(doc.get_all("service.section number 7", "list")
+                        .first->get_allocator()
+                        .resource() == &arena);
+#if __cplusplus >= 201103L
+        // Copies must not depend on the lifetime of the arena.
+        const document::param_vector copy(doc.params());
+        BOOST_CHECK(copy.get_allocator().resource() == new_delete_resource());
+        BOOST_CHECK(copy[42].name.get_allocator().resource() ==
+                    new_delete_resource());
+#endif
+    }
+    BOOST_CHECK(upstream.live == 0);
+
+    char buffer[4096];
+    monotonic_buffer_resource local(buffer, sizeof(buffer), &upstream);
+    document small(document::options(), &local);
+    const std::size_t before = upstream.allocations;
+    small.add_section("a");
+    small.add_param("x", "a value too long for SSO");
+    BOOST_CHECK(*small.get("a", "x") == "a value too long for SSO");
+    BOOST_CHECK(upstream.allocations == before);
+}
+
+BOOST_AUTO_TEST_CASE(test_document_swap) {
+    document::options opts;
+    opts.case_insensitive = true;
+    document a(opts), b;
+    a.add_section("a");
+    a.add_param("x", "1");
+    b.add_section("b");
+    a.swap(b);
+    BOOST_CHECK(!a.get_options().case_insensitive);
+    BOOST_CHECK(a.find_section("b") == 0);
+    BOOST_CHECK(a.find_section("a") == document::npos);
+    BOOST_CHECK(*b.get("A", "X") == "1");
+    b.add_param("y", "2");
+    BOOST_CHECK(*b.get("a", "y") == "2");
+}
@@ -0,0 +1,89 @@
+#include "config/ini/editable_document.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using config::ini::editable_document;
+
+BOOST_AUTO_TEST_CASE(test_editable_document_round_trip) {
+    const std::string content = "; leading comment\r\n"
+                                "[section] ; trailing comment\r\n"
+                                "  param1 =   value1   ; inline\r\n"
+                                "\t\n"
+                                "param2=value2";
+    std::istringstream is(content);
+    editable_document doc;
+    BOOST_REQUIRE(doc.load(is));
+    BOOST_CHECK(doc.str() == content);
+
+    std::string joined;
+    for (std::size_t i = 0; i < doc.segments().size(); ++i) {
+        const editable_document::segment &s = doc.segments()[i];
+        joined.append(content, s.offset, s.length);
+    }
+    BOOST_CHECK(joined == content);
+    BOOST_CHECK(doc.segments()[0].type == editable_document::segment::COMMENT);
+}
+
+BOOST_AUTO_TEST_CASE(test_editable_document_set_existing_value) {
+    std::istringstream is("[a]\n"
+                          "x = 1 ; keep me\n"
+                          "y =\n"
+                          "[b]\n"
+                          "x = 2\n");
+    editable_document doc;
+    BOOST_REQUIRE(doc.load(is));
+    BOOST_REQUIRE(doc.get("a", "x"));
+    BOOST_CHECK(*doc.get("a", "x") == "1");
+    BOOST_CHECK(*doc.get("a", "y") == "");
+
+    doc.set("a", "x", "100");
+    doc.set("a", "y", "filled");
+    BOOST_CHECK(*doc.get("a", "x") == "100");
+    BOOST_CHECK(doc.str() == "[a]\n"
+                             "x = 100 ; keep me\n"
+                             "y =filled\n"
+                             "[b]\n"
+                             "x = 2\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_editable_document_add_params) {
+    std::istringstream is("top = 0\n"
+                          "[a]\n"
+                          "x = 1 ; comment\n"
+                          "[b]\n"
+                          "z = 3");
+    editable_document doc;
+    BOOST_REQUIRE(doc.load(is));
+    doc.set("a", "y", "2");
+    doc.set("b", "w", "4");
+    doc.set("c", "v", "5");
+    BOOST_CHECK(doc.str() == "top = 0\n"
+                             "[a]\n"
+                             "x = 1 ; comment\n"
+                             "y = 2\n"
+                             "[b]\n"
+                             "z = 3\n"
+                             "w = 4\n"
+                             "[c]\n"
+                             "v = 5\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_editable_document_load_error) {
+    std::istringstream is("[section\n");
+    editable_document doc;
+    BOOST_CHECK(!doc.load(is, "broken.ini"));
+    BOOST_CHECK(doc.error().find("broken.ini") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_editable_document_quotes_values) {
+    std::istringstream is("[a]\n"
+                          "url = \"x;y\" ; comment\n");
+    editable_document doc;
+    BOOST_REQUIRE(doc.load(is));
+    BOOST_CHECK(*doc.get("a", "url") == "x;y");
+    doc.set("a", "url", "p;q");
+    doc.set("a", "path", "C:\\dir\\");
+    BOOST_CHECK(doc.str() == "[a]\n"
+                             "url = \"p;q\" ; comment\n"
+                             "path = \"C:\\\\dir\\\\\"\n");
+}
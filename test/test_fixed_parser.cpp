@@ -0,0 +1,115 @@
+#include "config/ini/fixed_parser.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <sstream>
+
+using config::ini::fixed_parser;
+using config::ini::parser;
+
+namespace {
+const char *const inputs[] = {
+    "[section]\r\nparam1=value1\r\n; some comment\r\nparam2 = value2 \r\n"
+    "\t\n[ section 2 ] ;comment\nparam3 = value3 ; inline comment",
+    "a = 'quoted \\t value' ; comment\nb = \"x\\\"y\"\n",
+    "long = first \\\n    second \\\r\n third\nslash = a\\b\n",
+    "!include other.ini ; comment\n[s]\nempty =\nlast =",
+    "\xEF\xBB\xBFx = 1\n[unterminated\n",
+    "a = 1\r\n; comment\rb = 2\n  [section\n",
+    "x = 'open\n",
+    "x = 1\n$\n",
+    "!bogus\n",
+    "[]\n",
+    "[ ]\nx = 1\n",
+    // Errors at the final line break point at the break.
+    "[[sec]\rkey\xff'...'\r",
+    "x = 1\nkey\n",
+};
+
+/**
+ * Checks that the fixed parser produces the same events as the stream
+ * parser with the same settings.
+ */
+void check_same_events(const char *input, std::size_t chunk_size = 0,
+                       const parser::limits &l = parser::limits()) {
+    std::istringstream in(input);
+    parser p("test.ini", in);
+    char scratch[64];
+    fixed_parser f(input, std::strlen(input), scratch, sizeof(scratch),
+                   "test.ini");
+    p.set_value_chunk_size(chunk_size);
+    f.set_value_chunk_size(chunk_size);
+    p.set_limits(l);
+    f.set_limits(l);
+    p.set_validate_utf8(true);
+    f.set_validate_utf8(true);
+    parser::event e;
+    fixed_parser::event fe;
+    for (;;) {
+        const bool ok = p.advance(e);
+        BOOST_CHECK(f.advance(fe) == ok);
+        BOOST_CHECK(fe.type == e.type);
+        BOOST_CHECK(std::string(fe.data, fe.size) == e.value);
+        BOOST_CHECK(fe.offset == e.offset);
+        BOOST_CHECK(fe.length == e.length);
+        if (!ok)
+            break;
+    }
+    BOOST_CHECK(f.line() == p.line());
+    BOOST_CHECK(f.column() == p.column());
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_fixed_parser_matches_parser) {
+    for (std::size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        check_same_events(inputs[i]);
+}
+
+BOOST_AUTO_TEST_CASE(test_fixed_parser_settings) {
+    // Parts of values held back in the scratch buffer and in the input.
+    const char *const chunked[] = {
+        "x = 'a\\tbcdefgh   ijk'\ny = abc   def  \\\n  ghijk   \n",
+        "x = abcdefgh\xC3\xA9ijkl\n",
+        "x = ab\xC3(\n",
+    };
+    for (std::size_t i = 0; i < sizeof(chunked) / sizeof(chunked[0]); ++i)
+        check_same_events(chunked[i], 4);
+
+    parser::limits l;
+    l.max_value = 5;
+    l.max_entries = 3;
+    check_same_events("a = 12345\nb = 123456\n", 0, l);
+    check_same_events("a = 1\nb = 2\n[c]\n", 0, l);
+    l = parser::limits();
+    l.max_bytes = 9;
+    check_same_events("a = 1\nb = 2\n", 0, l);
+}
+
+BOOST_AUTO_TEST_CASE(test_fixed_parser_views) {
+    const char input[] = "[main]\nplain = value\nescaped = 'a\\tb'\n";
+    char scratch[8];
+    fixed_parser p(input, sizeof(input) - 1, scratch, sizeof(scratch));
+    fixed_parser::event e;
+    BOOST_REQUIRE(p.advance(e));
+    BOOST_CHECK(e.data == input + 1);
+    BOOST_REQUIRE(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.data == input + 15);
+    BOOST_REQUIRE(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.data == scratch);
+    BOOST_CHECK(std::string(e.data, e.size) == "a\tb");
+}
+
+BOOST_AUTO_TEST_CASE(test_fixed_parser_scratch_overflow) {
+    const char input[] = "x = 'a value with an escape\\n'\n";
+    char scratch[8];
+    fixed_parser p(input, sizeof(input) - 1, scratch, sizeof(scratch),
+                   "small.ini");
+    fixed_parser::event e;
+    BOOST_REQUIRE(p.advance(e));
+    BOOST_CHECK(!p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_ERROR);
+    const std::string message(e.data, e.size);
+    BOOST_CHECK(message.find("small.ini:1:") == 0);
+    BOOST_CHECK(message.find("scratch buffer") != std::string::npos);
+    BOOST_CHECK(!p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_END);
+}
@@ -0,0 +1,61 @@
+#define BOOST_TEST_MODULE fixed_parser_alloc
+
+#include "config/ini/fixed_parser.hpp"
+#include <boost/test/included/unit_test.hpp>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using config::ini::basic_fixed_parser;
+using config::ini::parser;
+using config::ini::relaxed_dialect;
+
+namespace {
+/// Number of calls of the global operator new.  The replacement affects
+/// the whole program, so this test has an executable of its own.
+std::size_t allocations = 0;
+}
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *p) throw() { std::free(p); }
+
+void operator delete[](void *p) throw() { std::free(p); }
+
+#if __cplusplus >= 201402L
+void operator delete(void *p, std::size_t) throw() { std::free(p); }
+
+void operator delete[](void *p, std::size_t) throw() { std::free(p); }
+#endif
+
+BOOST_AUTO_TEST_CASE(test_fixed_parser_does_not_allocate) {
+    const char input[] = "# boot configuration\n[boot]\n_root: /dev/sda1\n"
+                         "cmdline = 'quiet \\\\ splash' ; comment\n"
+                         "modules = a \\\n b\n[broken\n";
+    char scratch[32];
+    {
+        // The replacement is in effect.
+        const std::size_t start = allocations;
+        const std::string probe(100, 'x');
+        BOOST_REQUIRE(allocations > start);
+    }
+    const std::size_t before = allocations;
+    basic_fixed_parser<relaxed_dialect> p(input, sizeof(input) - 1, scratch,
+                                          sizeof(scratch), "boot.ini");
+    basic_fixed_parser<relaxed_dialect>::event e;
+    std::size_t events = 0;
+    while (p.advance(e))
+        ++events;
+    const std::size_t after = allocations;
+    BOOST_CHECK(after == before);
+    BOOST_CHECK(events == 7);
+    BOOST_CHECK(e.type == parser::EVENT_ERROR);
+    BOOST_CHECK(std::string(e.data, e.size).find("boot.ini:7:8:") == 0);
+}
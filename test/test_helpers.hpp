@@ -0,0 +1,56 @@
+#ifndef CONFIG_INI_TEST_HELPERS_HPP
+#define CONFIG_INI_TEST_HELPERS_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Temporary directory removed with the files written by write().
+ */
+struct temp_dir {
+    temp_dir() {
+        char tmpl[] = "/tmp/config-ini-test.XXXXXX";
+        path = mkdtemp(tmpl);
+    }
+
+    ~temp_dir() {
+        for (std::size_t i = 0; i < files.size(); ++i)
+            unlink(files[i].c_str());
+        rmdir(path.c_str());
+    }
+
+    std::string write(const std::string &name, const std::string &content) {
+        const std::string file = path + "/" + name;
+        std::ofstream out(file.c_str());
+        out << content;
+        files.push_back(file);
+        return file;
+    }
+
+    std::string path;
+    std::vector<std::string> files;
+};
+
+/**
+ * Temporary file with the given content, removed by the destructor.
+ */
+struct temp_file {
+    explicit temp_file(const std::string &content) {
+        char tmpl[] = "/tmp/config-ini-test.XXXXXX";
+        const int fd = mkstemp(tmpl);
+        close(fd);
+        path = tmpl;
+        std::ofstream out(path.c_str());
+        out << content;
+    }
+
+    ~temp_file() { unlink(path.c_str()); }
+
+    std::string path;
+};
+
+#endif
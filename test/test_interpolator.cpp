@@ -0,0 +1,85 @@
+#include "config/ini/document.hpp"
+#include "config/ini/interpolator.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+#include <stdlib.h>
+
+using config::ini::document;
+using config::ini::interpolator;
+
+BOOST_AUTO_TEST_CASE(test_interpolator_expands_references) {
+    setenv("CONFIG_INI_TEST_HOME", "/home/test", 1);
+    document doc;
+    doc.add_section("paths");
+    doc.add_param("root", "${CONFIG_INI_TEST_HOME}/app");
+    doc.add_param("logs", "${paths:root}/logs");
+    doc.add_section("log");
+    doc.add_param("file", "${paths:logs}/app.log");
+    doc.add_param("price", "$$5 or ${incomplete");
+
+    interpolator in;
+    BOOST_REQUIRE(in.resolve(doc));
+    BOOST_CHECK(*in.get("log", "file") == "/home/test/app/logs/app.log");
+    BOOST_CHECK(*in.get("log", "price") == "$5 or ${incomplete");
+    BOOST_CHECK(in.expansions() == 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_interpolator_deep_chain_expands_each_once) {
+    document doc;
+    doc.add_section("s");
+    doc.add_param("k0", "x");
+    const std::size_t depth = 100000;
+    for (std::size_t i = 1; i < depth; ++i) {
+        std::ostringstream name, value;
+        name << "k" << i;
+        value << "${s:k" << i - 1 << "}";
+        doc.add_param(name.str(), value.str());
+    }
+    interpolator in;
+    BOOST_REQUIRE(in.resolve(doc));
+    BOOST_CHECK(in.expansions() == depth);
+    BOOST_CHECK(*in.get("s", "k99999") == "x");
+}
+
+BOOST_AUTO_TEST_CASE(test_interpolator_reload_resolves_affected_values) {
+    document doc;
+    doc.add_section("a");
+    doc.add_param("base", "1");
+    doc.add_param("derived", "${a:base}+");
+    doc.add_param("other", "2");
+    doc.add_param("user", "${a:other}!");
+
+    interpolator in;
+    BOOST_REQUIRE(in.resolve(doc));
+    BOOST_REQUIRE(in.reload(doc));
+    BOOST_CHECK(in.expansions() == 0);
+
+    document changed;
+    changed.add_section("a");
+    changed.add_param("base", "10");
+    changed.add_param("derived", "${a:base}+");
+    changed.add_param("other", "2");
+    changed.add_param("user", "${a:other}!");
+    BOOST_REQUIRE(in.reload(changed));
+    BOOST_CHECK(in.expansions() == 2);
+    BOOST_CHECK(*in.get("a", "derived") == "10+");
+    BOOST_CHECK(*in.get("a", "user") == "2!");
+}
+
+BOOST_AUTO_TEST_CASE(test_interpolator_errors) {
+    document doc;
+    doc.add_section("a");
+    doc.add_param("x", "${a:y}");
+    doc.add_param("y", "${a:z}");
+    doc.add_param("z", "${a:x}");
+    interpolator in;
+    BOOST_CHECK(!in.resolve(doc));
+    BOOST_CHECK(in.error().find("reference cycle") != std::string::npos);
+
+    document missing;
+    missing.add_param("x", "${nowhere:y}");
+    BOOST_CHECK(!in.resolve(missing));
+    BOOST_CHECK(in.error().find("unresolved reference ${nowhere:y}") !=
+                std::string::npos);
+}
@@ -0,0 +1,58 @@
+#include "config/ini/document.hpp"
+#include "config/ini/layered.hpp"
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+
+using config::ini::document;
+using config::ini::layered;
+
+BOOST_AUTO_TEST_CASE(test_layered_overrides) {
+    document base;
+    base.add_section("db");
+    base.add_param("host", "localhost");
+    base.add_param("port", "5432");
+    base.add_param("replica[]", "a");
+    base.add_param("replica[]", "b");
+    document host;
+    host.add_section("db");
+    host.add_param("port", "6432");
+    document flags;
+    const char *argv[] = { "--db.host=remote", "input.txt", "--verbose" };
+    std::vector<std::string> rest;
+    BOOST_REQUIRE(config::ini::load_arguments(3, argv, flags, &rest));
+    BOOST_CHECK(rest.size() == 2 && rest[0] == "input.txt");
+
+    layered view;
+    view.push(base);
+    view.push(host);
+    view.push(flags);
+    for (int pass = 0; pass < 2; ++pass) {
+        BOOST_CHECK(view.flattened() == (pass == 1));
+        BOOST_CHECK(*view.get("db", "host") == "remote");
+        BOOST_CHECK(*view.get("db", "port") == "6432");
+        BOOST_CHECK(!view.get("db", "user"));
+        BOOST_CHECK(view.get_all("db", "replica").size() == 2);
+        BOOST_CHECK(view.get_all("app", "x").empty());
+        view.flatten();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_layered_environment) {
+    setenv("CONFIG_INI_TEST_DB__HOST", "env-host", 1);
+    setenv("CONFIG_INI_TEST_DEBUG", "1", 1);
+    document env;
+    BOOST_REQUIRE(config::ini::load_environment("CONFIG_INI_TEST_", env));
+    unsetenv("CONFIG_INI_TEST_DB__HOST");
+    unsetenv("CONFIG_INI_TEST_DEBUG");
+
+    document base;
+    base.add_section("db");
+    base.add_param("host", "localhost");
+    layered view;
+    view.push(base);
+    view.push(env);
+    view.flatten();
+    BOOST_CHECK(*view.get("db", "host") == "env-host");
+    BOOST_CHECK(*view.get("", "debug") == "1");
+}
@@ -0,0 +1,91 @@
+#include "config/ini/lazy_document.hpp"
+#include "test_helpers.hpp"
+#include <boost/test/unit_test.hpp>
+
+using config::ini::document;
+using config::ini::lazy_document;
+
+BOOST_AUTO_TEST_CASE(test_lazy_document_loads_accessed_sections) {
+    temp_file f("top = 0\n"
+                "[a]\n"
+                "x = 1 \\\n"
+                "[not a section]\n"
+                "[b]\n"
+                "y = 2\n"
+                "[a]\n"
+                "z = \"3\\\\\"\n"
+                "[c]\n"
+                "w = 4\n");
+    lazy_document doc;
+    BOOST_REQUIRE(doc.open(f.path));
+    BOOST_CHECK(doc.section_count() == 4);
+    BOOST_CHECK(doc.loaded_sections() == 0);
+
+    BOOST_REQUIRE(doc.get("a", "x"));
+    BOOST_CHECK(*doc.get("a", "x") == "1 [not a section]");
+    BOOST_CHECK(*doc.get("a", "z") == "3\\");
+    BOOST_CHECK(doc.loaded_sections() == 1);
+    BOOST_CHECK(!doc.get_document().get("b", "y"));
+
+    BOOST_CHECK(*doc.get("", "top") == "0");
+    BOOST_CHECK(!doc.get("missing", "x"));
+    BOOST_CHECK(doc.loaded_sections() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_document_reports_errors_on_access) {
+    temp_file f("[a]\n"
+                "x = 1\n"
+                "[b]\n"
+                "y = \"open\n");
+    lazy_document doc;
+    BOOST_REQUIRE(doc.open(f.path));
+    BOOST_CHECK(*doc.get("a", "x") == "1");
+    BOOST_CHECK(!doc.get("b", "y"));
+    BOOST_CHECK(doc.error().find(f.path + ":4:") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_document_indexes_empty_first_section) {
+    temp_file f("[a]\n"
+                "[b]\n"
+                "y = 2\n");
+    lazy_document doc;
+    BOOST_REQUIRE(doc.open(f.path));
+    BOOST_CHECK(doc.section_count() == 2);
+    BOOST_CHECK(!doc.get("a", "y"));
+    BOOST_CHECK(*doc.get("b", "y") == "2");
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_document_carriage_returns) {
+    temp_file f("[a]\rx = 1\r"
+                "[b]\ry = 2\r\n"
+                "[c]\r\nz = \"open\r");
+    lazy_document doc;
+    BOOST_REQUIRE(doc.open(f.path));
+    BOOST_CHECK(doc.section_count() == 3);
+    BOOST_REQUIRE(doc.get("b", "y"));
+    BOOST_CHECK(*doc.get("b", "y") == "2");
+    BOOST_CHECK(doc.loaded_sections() == 1);
+    BOOST_CHECK(!doc.get("c", "z"));
+    BOOST_CHECK(doc.error().find(f.path + ":6:") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_document_keeps_section_errors) {
+    temp_file f("[a]\n"
+                "x = 1\n"
+                "[b]\n"
+                "y = 2\n"
+                "[a]\n"
+                "z = \"open\n");
+    document::options opts;
+    opts.duplicate_params = document::DUPLICATE_ERROR;
+    lazy_document doc(opts);
+    BOOST_REQUIRE(doc.open(f.path));
+    BOOST_CHECK(!doc.get("a", "x"));
+    const std::string error = doc.error();
+    BOOST_CHECK(error.find(f.path + ":6:") == 0);
+    // The first occurrence is not added again.
+    BOOST_CHECK(!doc.get("a", "x"));
+    BOOST_CHECK(doc.error() == error);
+    BOOST_CHECK(*doc.get("b", "y") == "2");
+    BOOST_CHECK(doc.loaded_sections() == 1);
+}
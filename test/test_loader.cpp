@@ -0,0 +1,117 @@
+#include "config/ini/document.hpp"
+#include "config/ini/loader.hpp"
+#include "test_helpers.hpp"
+#include <boost/test/unit_test.hpp>
+
+using config::ini::document;
+using config::ini::loader;
+
+BOOST_AUTO_TEST_CASE(test_loader_includes_shared_file_once) {
+    temp_dir dir;
+    dir.write("base.ini", "[db]\nhost = localhost\nport = 5432\n");
+    const std::string a = dir.write("a.ini", "!include base.ini\n"
+                                             "[db]\nport = 6432\n");
+    const std::string b = dir.write("b.ini", "[app]\nname = b\n"
+                                             "!include ./base.ini ; shared\n");
+    loader l;
+    document da, db;
+    BOOST_REQUIRE(l.load(a, da));
+    BOOST_REQUIRE(l.load(b, db));
+    BOOST_CHECK(l.parsed_files() == 3);
+
+    BOOST_CHECK(*da.get("db", "host") == "localhost");
+    BOOST_CHECK(*da.get("db", "port") == "6432");
+    BOOST_CHECK(*db.get("app", "name") == "b");
+    BOOST_CHECK(*db.get("db", "port") == "5432");
+}
+
+BOOST_AUTO_TEST_CASE(test_loader_detects_cycles) {
+    temp_dir dir;
+    const std::string a = dir.write("a.ini", "!include b.ini\n");
+    dir.write("b.ini", "x = 1\n!include a.ini\n");
+    loader l;
+    document doc;
+    BOOST_CHECK(!l.load(a, doc));
+    BOOST_CHECK(l.error().find("include cycle") != std::string::npos);
+    BOOST_CHECK(l.error().find("included from") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_loader_reports_include_chain) {
+    temp_dir dir;
+    const std::string a = dir.write("a.ini", "!include b.ini\n");
+    dir.write("b.ini", "[broken\n");
+    loader l;
+    document doc;
+    BOOST_CHECK(!l.load(a, doc));
+    BOOST_CHECK(l.error().find("b.ini:1:") != std::string::npos);
+    BOOST_CHECK(l.error().find("included from " + dir.path) !=
+                std::string::npos);
+
+    BOOST_CHECK(!l.load(dir.path + "/missing.ini", doc));
+    BOOST_CHECK(l.error().find("cannot open") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_loader_unreadable_includes) {
+    temp_dir dir;
+    const std::string a = dir.write("a.ini", "x = 1\n!include .\n");
+    const std::string b = dir.write("b.ini", "!include missing.ini\n");
+    for (int readahead = 0; readahead < 2; ++readahead) {
+        loader l;
+        l.set_readahead(readahead != 0);
+        document doc;
+        BOOST_CHECK(!l.load(a, doc));
+        BOOST_CHECK(l.error().find(dir.path + ": read") == 0);
+        BOOST_CHECK(l.error().find("included from " + a) !=
+                    std::string::npos);
+        BOOST_CHECK(!l.load(b, doc));
+        BOOST_CHECK(l.error().find("missing.ini: cannot open") !=
+                    std::string::npos);
+        BOOST_CHECK(l.error().find("included from " + b) !=
+                    std::string::npos);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_loader_reports_duplicates) {
+    temp_dir dir;
+    const std::string path = dir.write("dup.ini", "[a]\nx = 1\nx = 2\n");
+    document::options opts;
+    opts.duplicate_params = document::DUPLICATE_ERROR;
+    document doc(opts);
+    loader l;
+    BOOST_CHECK(!l.load(path, doc));
+    BOOST_CHECK(l.error().find("duplicate parameter 'x'") !=
+                std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_loader_limits) {
+    temp_dir dir;
+    dir.write("c.ini", "[c]\nx = 1\n");
+    dir.write("b.ini", "!include c.ini\n");
+    const std::string a = dir.write("a.ini", "!include b.ini\n");
+    const std::string wide = dir.write("wide.ini", "!include c.ini\n"
+                                                   "!include c.ini\n"
+                                                   "!include c.ini\n");
+
+    config::ini::parser::limits l;
+    l.max_include_depth = 1;
+    loader ld;
+    ld.set_limits(l);
+    document doc;
+    BOOST_CHECK(!ld.load(a, doc));
+    BOOST_CHECK(ld.exceeded_limit() ==
+                config::ini::parser::limits::LIMIT_INCLUDE_DEPTH);
+    BOOST_CHECK(ld.error().find("nested deeper than 1") != std::string::npos);
+
+    // Entries are counted across repeated includes.
+    l.max_include_depth = 2;
+    l.max_entries = 8;
+    ld.set_limits(l);
+    document doc2;
+    BOOST_CHECK(ld.load(a, doc2));
+    BOOST_CHECK(ld.exceeded_limit() ==
+                config::ini::parser::limits::LIMIT_NONE);
+    document doc3;
+    BOOST_CHECK(!ld.load(wide, doc3));
+    BOOST_CHECK(ld.exceeded_limit() ==
+                config::ini::parser::limits::LIMIT_ENTRIES);
+}
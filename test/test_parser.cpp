@@ -5,16 +5,20 @@
 #include <sstream>
 
 using config::ini::parser;
+using config::ini::basic_parser;
+using config::ini::relaxed_dialect;
 
 BOOST_AUTO_TEST_CASE(test_simple_event_sequence) {
-    const parser::event expected[] = { { parser::EVENT_SECTION, "section" },
-                                       { parser::EVENT_NAME, "param1" },
-                                       { parser::EVENT_VALUE, "value1" },
-                                       { parser::EVENT_NAME, "param2" },
-                                       { parser::EVENT_VALUE, "value2" },
-                                       { parser::EVENT_SECTION, "section 2" },
-                                       { parser::EVENT_NAME, "param3" },
-                                       { parser::EVENT_VALUE, "value3" }, };
+    const parser::event expected[] = {
+        { parser::EVENT_SECTION, "section", 0, 0 },
+        { parser::EVENT_NAME, "param1", 0, 0 },
+        { parser::EVENT_VALUE, "value1", 0, 0 },
+        { parser::EVENT_NAME, "param2", 0, 0 },
+        { parser::EVENT_VALUE, "value2", 0, 0 },
+        { parser::EVENT_SECTION, "section 2", 0, 0 },
+        { parser::EVENT_NAME, "param3", 0, 0 },
+        { parser::EVENT_VALUE, "value3", 0, 0 },
+    };
     const std::size_t num_events = sizeof(expected) / sizeof(expected[0]);
 
     std::string content = "[section]\r\n"
@@ -57,3 +61,393 @@ BOOST_AUTO_TEST_CASE(test_unexpected_starting_symbol) {
     BOOST_MESSAGE(e.value);
     BOOST_CHECK(e.value.find("symbol '!'") != std::string::npos);
 }
+
+BOOST_AUTO_TEST_CASE(test_parser_statistics) {
+    std::istringstream is("; comment\n"
+                          "[section]\n"
+                          "  param = value\n"
+                          "[broken");
+    parser p(is);
+    parser::event e;
+    while (p.advance(e))
+        ;
+    const parser::stats &s = p.statistics();
+    if (!parser::stats::enabled) {
+        BOOST_CHECK(s.bytes == 0);
+        return;
+    }
+    BOOST_CHECK(s.bytes == is.str().size());
+    BOOST_CHECK(s.events[parser::EVENT_SECTION] == 1);
+    BOOST_CHECK(s.events[parser::EVENT_NAME] == 1);
+    BOOST_CHECK(s.events[parser::EVENT_VALUE] == 1);
+    BOOST_CHECK(s.events[parser::EVENT_ERROR] == 1);
+    BOOST_CHECK(s.errors == 1);
+    BOOST_CHECK(s.comment_bytes == 8);
+    BOOST_CHECK(s.whitespace_bytes > 0);
+    BOOST_CHECK(s.put_backs > 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_include_directive) {
+    std::istringstream is("!include base.ini ; comment\n"
+                          "[section]\n"
+                          "!include  other dir/x.ini\n");
+    parser p(is);
+    parser::event e;
+    BOOST_CHECK(p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_INCLUDE);
+    BOOST_CHECK(e.value == "base.ini");
+    BOOST_CHECK(p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_SECTION);
+    BOOST_CHECK(p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_INCLUDE);
+    BOOST_CHECK(e.value == "other dir/x.ini");
+    BOOST_CHECK(!p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_END);
+}
+
+BOOST_AUTO_TEST_CASE(test_value_continuation_lines) {
+    std::istringstream is("hosts = a, \\\n"
+                          "        b,\\\r\n"
+                          "\tc ; comment\n"
+                          "path = C:\\dir\\\n"
+                          "\n"
+                          "next = 1");
+    parser p(is);
+    parser::event e;
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value == "a, b,c");
+    BOOST_CHECK(e.length == is.str().find(" ; comment") - e.offset);
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value == "C:\\dir");
+    BOOST_CHECK(p.advance(e) && e.value == "next");
+}
+
+BOOST_AUTO_TEST_CASE(test_long_continued_value) {
+    std::string content = "acl = ";
+    for (std::size_t i = 0; i < 100000; ++i)
+        content.append("10.0.0.1, \\\n    ");
+    content.append("10.0.0.2\n");
+    std::istringstream is(content);
+    parser p(is);
+    parser::event e;
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value.size() == 100000 * 10 + 8);
+    BOOST_CHECK(e.offset + e.length == content.size() - 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_quoted_values) {
+    const std::string secret(100, 'x');
+    std::istringstream is("url = \"http://host/a;b#c\" ; comment\n"
+                          "secret = '" + secret + "'\n"
+                          "escaped = \"tab\\there \\\"quoted\\\" \\\\\"\n"
+                          "padded = \"  spaces  \"");
+    parser p(is);
+    parser::event e;
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value == "http://host/a;b#c");
+    BOOST_CHECK(e.offset == 6 && e.length == 19);
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value == secret);
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value == "tab\there \"quoted\" \\");
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value == "  spaces  ");
+    BOOST_CHECK(!p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_END);
+}
+
+BOOST_AUTO_TEST_CASE(test_unterminated_quoted_value) {
+    std::istringstream is("key = \"value\nnext = 1\n");
+    parser p(is);
+    parser::event e;
+    BOOST_CHECK(p.advance(e));
+    BOOST_CHECK(!p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_ERROR);
+    BOOST_CHECK(e.value.find("end of line") != std::string::npos);
+
+    std::istringstream trailing("key = \"value\" junk\n");
+    parser q(trailing);
+    BOOST_CHECK(q.advance(e));
+    BOOST_CHECK(!q.advance(e));
+    BOOST_CHECK(e.value.find("symbol 'j'") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_utf8_bom_is_skipped) {
+    std::istringstream is("\xEF\xBB\xBF[section]\nkey = \xD0\xB7\xD0\xBD\n");
+    parser p(is);
+    parser::event e;
+    BOOST_CHECK(p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_SECTION);
+    BOOST_CHECK(e.offset == 4);
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(e.value == "\xD0\xB7\xD0\xBD");
+}
+
+BOOST_AUTO_TEST_CASE(test_utf8_validation) {
+    const char *invalid[] = { "key = a\xC0\xAFz\n", // overlong
+                              "key = \xED\xA0\x80\n", // surrogate
+                              "key = \xE2\x82" };     // truncated
+    const std::size_t offsets[] = { 7, 7, 8 };
+    for (std::size_t i = 0; i < 3; ++i) {
+        std::istringstream is(invalid[i]);
+        parser p(is);
+        p.set_validate_utf8(true);
+        parser::event e;
+        while (p.advance(e))
+            ;
+        BOOST_CHECK(e.type == parser::EVENT_ERROR);
+        BOOST_CHECK(e.value.find("invalid UTF-8") != std::string::npos);
+        BOOST_CHECK(e.offset == offsets[i]);
+    }
+
+    // The euro sign crosses the boundary of the parser input buffer.
+    std::string valid(65529, 'a');
+    valid = "key = " + valid + "\xE2\x82\xAC\xF0\x9F\x98\x80\n";
+    std::istringstream is(valid);
+    parser p(is);
+    p.set_validate_utf8(true);
+    parser::event e;
+    BOOST_CHECK(p.advance(e) && p.advance(e));
+    BOOST_CHECK(!p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_END);
+}
+
+BOOST_AUTO_TEST_CASE(test_error_positions) {
+    // "\r\n" and a lone "\r" are single line breaks.
+    std::istringstream is("a = 1\r\n; comment\rb = 2\n  [section\n");
+    parser p("test.ini", is);
+    parser::event e;
+    while (p.advance(e))
+        ;
+    BOOST_CHECK(e.type == parser::EVENT_ERROR);
+    BOOST_CHECK(e.value.find("test.ini:4:11:") == 0);
+
+    // Line breaks are counted across input buffers, including "\r\n"
+    // split by a buffer boundary.
+    std::string big;
+    for (std::size_t i = 0; big.size() < 65535 - 8; ++i)
+        big += "k = v\n";
+    big.append(65535 - big.size(), ';');
+    big += "\r\n\r\n  $";
+    std::istringstream bis(big);
+    parser q(bis);
+    std::size_t lines = 0;
+    for (std::size_t i = 0; i < big.size(); ++i)
+        lines += big[i] == '\n';
+    while (q.advance(e))
+        ;
+    BOOST_CHECK(e.type == parser::EVENT_ERROR);
+    std::ostringstream expected;
+    expected << ":" << lines + 1 << ":4:";
+    BOOST_CHECK(e.value.find(expected.str()) != std::string::npos);
+    BOOST_CHECK(q.line() == lines + 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_parser_reset_and_move) {
+    std::istringstream first("[a]\nx = 1\n");
+    parser p("first.ini", first);
+    parser::event e;
+    BOOST_CHECK(p.advance(e) && e.value == "a");
+
+    std::istringstream second("bad\n");
+    p.reset(second, "second.ini");
+    while (p.advance(e))
+        ;
+    BOOST_CHECK(e.type == parser::EVENT_ERROR);
+    BOOST_CHECK(e.value.find("second.ini:1:") == 0);
+
+    parser idle;
+    BOOST_CHECK(!idle.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_END);
+
+#if __cplusplus >= 201103L
+    std::istringstream third("[b]\ny = 2\n");
+    p.reset(third, "third.ini");
+    BOOST_CHECK(p.advance(e) && e.value == "b");
+    parser moved(std::move(p));
+    BOOST_CHECK(moved.advance(e) && e.value == "y");
+    BOOST_CHECK(!p.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_END);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(test_relaxed_dialect) {
+    std::istringstream in("# comment\n[main]\n_private: 1\n"
+                          "x-header = 2 # note\n.hidden=3\n");
+    basic_parser<relaxed_dialect> p(in);
+    std::vector<std::string> values;
+    parser::event e;
+    while (p.advance(e))
+        values.push_back(e.value);
+    BOOST_CHECK(e.type == parser::EVENT_END);
+    const char *expected[] = { "main", "_private", "1", "x-header", "2",
+                               ".hidden", "3" };
+    BOOST_CHECK(values == std::vector<std::string>(expected, expected + 7));
+
+    std::istringstream strict("[main]\n_private = 1\n");
+    parser q(strict);
+    while (q.advance(e))
+        ;
+    BOOST_CHECK(e.type == parser::EVENT_ERROR);
+}
+
+BOOST_AUTO_TEST_CASE(test_value_chunks) {
+    std::string blob, expected;
+    while (blob.size() < 200000) {
+        blob += "0123456789abcdef \\\n  ";
+        expected += "0123456789abcdef ";
+    }
+    blob += "end";
+    expected += "end";
+    const std::string quoted = "'" + std::string(150000, 'q') + "\\t" +
+                               std::string(1000, 'r') + "'";
+    const std::string input = "[certs]\nplain = " + blob + "   \n" +
+                              "quoted = " + quoted + "\nsmall = x\n";
+    std::istringstream is(input);
+    parser p(is);
+    p.set_value_chunk_size(4096);
+    parser::event e;
+    std::vector<std::string> values;
+    std::vector<std::string> sources;
+    std::string value;
+    std::size_t parts = 0;
+    while (p.advance(e)) {
+        if (e.type == parser::EVENT_VALUE_PART) {
+            BOOST_CHECK(!e.value.empty() && e.value.size() <= 4096);
+            value += e.value;
+            ++parts;
+        } else if (e.type == parser::EVENT_VALUE) {
+            values.push_back(value + e.value);
+            sources.push_back(input.substr(e.offset, e.length));
+            value.clear();
+        }
+    }
+    BOOST_CHECK(e.type == parser::EVENT_END);
+    BOOST_REQUIRE(values.size() == 3);
+    BOOST_CHECK(values[0] == expected);
+    BOOST_CHECK(sources[0] == blob);
+    BOOST_CHECK(values[1] == std::string(150000, 'q') + "\t" +
+                                 std::string(1000, 'r'));
+    BOOST_CHECK(sources[1] == quoted);
+    BOOST_CHECK(values[2] == "x");
+    // Parts are close to the chunk size.
+    BOOST_CHECK(parts >= expected.size() / 4096 + 151001 / 4096 - 1);
+
+    // Without a chunk size values come whole.
+    std::istringstream whole(input);
+    parser q(whole);
+    std::size_t events = 0;
+    while (q.advance(e)) {
+        BOOST_CHECK(e.type != parser::EVENT_VALUE_PART);
+        ++events;
+    }
+    BOOST_CHECK(events == 7);
+}
+
+namespace {
+/**
+ * Parses \p input with limits \p l and returns the limit that stopped
+ * parsing.
+ */
+parser::limits::kind exceeded(const std::string &input,
+                              const parser::limits &l, std::string *error) {
+    std::istringstream is(input);
+    parser p("limits.ini", is);
+    p.set_limits(l);
+    parser::event e;
+    while (p.advance(e))
+        ;
+    if (error)
+        *error = e.value;
+    BOOST_CHECK(p.exceeded_limit() == parser::limits::LIMIT_NONE ||
+                e.type == parser::EVENT_ERROR);
+    return p.exceeded_limit();
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_parser_limits) {
+    parser::limits l;
+    l.max_bytes = 64;
+    l.max_section = 8;
+    l.max_key = 4;
+    l.max_value = 16;
+    l.max_entries = 4;
+
+    std::string error;
+    BOOST_CHECK(exceeded("[main]\nkey = value\n", l, 0) ==
+                parser::limits::LIMIT_NONE);
+    BOOST_CHECK(exceeded("[long section]\n", l, &error) ==
+                parser::limits::LIMIT_SECTION);
+    BOOST_CHECK(error == "limits.ini:1:10: section name longer than 8 bytes");
+    BOOST_CHECK(exceeded("toolong = 1\n", l, 0) ==
+                parser::limits::LIMIT_KEY);
+    BOOST_CHECK(exceeded("k = " + std::string(17, 'v') + "\n", l, 0) ==
+                parser::limits::LIMIT_VALUE);
+    BOOST_CHECK(exceeded("k = '" + std::string(17, 'v') + "'\n", l, 0) ==
+                parser::limits::LIMIT_VALUE);
+    BOOST_CHECK(exceeded("k = 'a\\t" + std::string(15, 'v') + "'\n", l,
+                         0) == parser::limits::LIMIT_VALUE);
+    BOOST_CHECK(exceeded("!include " + std::string(17, 'p') + "\n", l, 0) ==
+                parser::limits::LIMIT_VALUE);
+    BOOST_CHECK(exceeded("a=1\nb=2\n[s]\nc=3\nd=4\n", l, &error) ==
+                parser::limits::LIMIT_ENTRIES);
+    BOOST_CHECK(error.find("more than 4 entries") != std::string::npos);
+    BOOST_CHECK(exceeded("; " + std::string(100, 'c') + "\n", l, &error) ==
+                parser::limits::LIMIT_BYTES);
+    BOOST_CHECK(error.find("input longer than 64 bytes") !=
+                std::string::npos);
+
+    // A huge line without a line break stops at the value limit instead
+    // of being buffered whole.
+    l.max_bytes = parser::limits::unlimited;
+    l.max_value = 1024;
+    BOOST_CHECK(exceeded("k = " + std::string(1 << 22, 'x'), l, 0) ==
+                parser::limits::LIMIT_VALUE);
+}
+
+BOOST_AUTO_TEST_CASE(test_parser_byte_limit_inside_token) {
+    parser::limits l;
+    l.max_bytes = 16;
+    const char *inputs[] = { "key = value that is cut\n",
+                             "[a section that is cut]\n",
+                             "a_key_that_is_cut = 1\n",
+                             "k = 'quoted value is cut'\n",
+                             "!include a/path/that/is/cut\n" };
+    for (std::size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        std::istringstream is(inputs[i]);
+        parser p("limits.ini", is);
+        p.set_limits(l);
+        parser::event e;
+        while (p.advance(e))
+            // No token is emitted from the cut input.
+            BOOST_CHECK(e.type == parser::EVENT_NAME);
+        BOOST_CHECK(e.type == parser::EVENT_ERROR);
+        BOOST_CHECK(e.value.find("input longer than 16 bytes") !=
+                    std::string::npos);
+        BOOST_CHECK(p.exceeded_limit() == parser::limits::LIMIT_BYTES);
+        BOOST_CHECK(!p.advance(e));
+        BOOST_CHECK(e.type == parser::EVENT_END);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_utf8_error_inside_token) {
+    const char *inputs[] = { "key = ab\xFF" "cd\n",
+                             "k\xFFy = 1\n",
+                             "[s\xFFt]\n",
+                             "k = 'a\xFF'\n" };
+    const std::size_t offsets[] = { 8, 1, 2, 6 };
+    for (std::size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        std::istringstream is(inputs[i]);
+        parser p(is);
+        p.set_validate_utf8(true);
+        parser::event e;
+        while (p.advance(e))
+            BOOST_CHECK(e.type == parser::EVENT_NAME);
+        BOOST_CHECK(e.type == parser::EVENT_ERROR);
+        BOOST_CHECK(e.value.find("invalid UTF-8 sequence") !=
+                    std::string::npos);
+        BOOST_CHECK(e.offset == offsets[i]);
+        BOOST_CHECK(!p.advance(e));
+        BOOST_CHECK(e.type == parser::EVENT_END);
+    }
+}
@@ -0,0 +1,68 @@
+#include "config/ini/parser_pool.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+#include <pthread.h>
+
+using config::ini::parser;
+using config::ini::parser_pool;
+
+namespace {
+void *parse_many(void *arg) {
+    parser_pool &pool = *static_cast<parser_pool *>(arg);
+    std::size_t values = 0;
+    for (int i = 0; i < 200; ++i) {
+        std::istringstream in("[s]\nx = 1\ny = 2\n");
+        parser_pool::lease p(pool, in, "pooled.ini");
+        parser::event e;
+        while (p->advance(e))
+            values += e.type == parser::EVENT_VALUE;
+    }
+    return reinterpret_cast<void *>(values);
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_parser_pool_reuses_parsers) {
+    parser_pool pool(2);
+    std::istringstream in("x = 1\n");
+    parser *first = pool.acquire(in, "a.ini");
+    pool.release(first);
+    BOOST_CHECK(pool.idle() == 1);
+    parser *second = pool.acquire(in, "b.ini");
+    BOOST_CHECK(second == first);
+    pool.release(second);
+
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i)
+        pthread_create(&threads[i], 0, &parse_many, &pool);
+    for (int i = 0; i < 4; ++i) {
+        void *values;
+        pthread_join(threads[i], &values);
+        BOOST_CHECK(reinterpret_cast<std::size_t>(values) == 400);
+    }
+    BOOST_CHECK(pool.idle() <= 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_parser_pool_resets_settings) {
+    parser_pool pool(1);
+    const std::string input = "k = " + std::string(100, 'v') + "\xFF\n";
+    {
+        std::istringstream in(input);
+        parser_pool::lease p(pool, in, "first.ini");
+        parser::limits l;
+        l.max_value = 10;
+        p->set_limits(l);
+        p->set_value_chunk_size(8);
+        p->set_validate_utf8(true);
+    }
+    std::istringstream in(input);
+    parser_pool::lease p(pool, in, "second.ini");
+    parser::event e;
+    BOOST_REQUIRE(p->advance(e) && e.type == parser::EVENT_NAME);
+    // No limit, no parts and no validation.
+    BOOST_REQUIRE(p->advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_VALUE);
+    BOOST_CHECK(e.value.size() == 101);
+    BOOST_CHECK(!p->advance(e) && e.type == parser::EVENT_END);
+    BOOST_CHECK(p->exceeded_limit() == parser::limits::LIMIT_NONE);
+}
@@ -0,0 +1,101 @@
+#include "config/ini/document.hpp"
+#include "config/ini/loader.hpp"
+#include "config/ini/readahead.hpp"
+#include "test_helpers.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+#include <unistd.h>
+
+using config::ini::document;
+using config::ini::loader;
+using config::ini::parser;
+using config::ini::readahead_buf;
+
+namespace {
+std::string sample(std::size_t sections) {
+    std::ostringstream ss;
+    for (std::size_t i = 0; i < sections; ++i) {
+        ss << "[section " << i << "] ; comment\n";
+        ss << "name = value " << i << "\n";
+        ss << "quoted = 'a\\tb'\n";
+        ss << "folded = first \\\n  second\n";
+    }
+    return ss.str();
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_readahead_matches_stream) {
+    const std::string content = sample(500);
+    temp_file file(content);
+    // Small blocks, so the ring wraps around many times.
+    readahead_buf buf(100, 3);
+    BOOST_REQUIRE(buf.open(file.path));
+    std::istream in(&buf);
+    parser p(file.path, in);
+    std::istringstream ref_in(content);
+    parser ref(file.path, ref_in);
+    parser::event e, ref_e;
+    std::size_t events = 0;
+    for (;;) {
+        const bool ok = p.advance(e);
+        BOOST_REQUIRE(ref.advance(ref_e) == ok);
+        BOOST_REQUIRE(e.type == ref_e.type);
+        BOOST_REQUIRE(e.value == ref_e.value);
+        BOOST_REQUIRE(e.offset == ref_e.offset);
+        if (!ok)
+            break;
+        ++events;
+    }
+    BOOST_CHECK(e.type == parser::EVENT_END);
+    BOOST_CHECK(events == 3500);
+    BOOST_CHECK(buf.error().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_readahead_close_while_ahead) {
+    temp_file file(sample(1000));
+    readahead_buf buf(64, 2);
+    BOOST_REQUIRE(buf.open(file.path));
+    // The producer fills the ring and waits for the reader, closing must
+    // stop it anyway.
+    std::istream in(&buf);
+    char c;
+    BOOST_CHECK(in.get(c) && c == '[');
+    usleep(10000);
+    buf.close();
+    BOOST_CHECK(!buf.is_open());
+    BOOST_REQUIRE(buf.open(file.path));
+    std::string line;
+    in.clear();
+    BOOST_CHECK(std::getline(in, line) && line == "[section 0] ; comment");
+}
+
+BOOST_AUTO_TEST_CASE(test_readahead_errors) {
+    readahead_buf buf;
+    BOOST_CHECK(!buf.open("/nonexistent/file.ini"));
+    BOOST_CHECK(buf.error().find("/nonexistent/file.ini: open:") == 0);
+
+    // Reading a directory fails after it is opened.
+    BOOST_REQUIRE(buf.open("/tmp"));
+    std::istream in(&buf);
+    char c;
+    BOOST_CHECK(!in.get(c));
+    BOOST_CHECK(buf.error().find("/tmp: read:") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_loader_readahead) {
+    temp_file file(sample(200));
+    loader l;
+    l.set_readahead(true);
+    document doc;
+    BOOST_REQUIRE(l.load(file.path, doc));
+    const config::ini::string *v = doc.get("section 199", "name");
+    BOOST_REQUIRE(v);
+    BOOST_CHECK(*v == "value 199");
+    v = doc.get("section 7", "quoted");
+    BOOST_REQUIRE(v);
+    BOOST_CHECK(*v == "a\tb");
+    v = doc.get("section 7", "folded");
+    BOOST_REQUIRE(v);
+    BOOST_CHECK(*v == "first second");
+}
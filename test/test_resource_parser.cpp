@@ -0,0 +1,66 @@
+#include "config/ini/resource_parser.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+using config::ini::monotonic_buffer_resource;
+using config::ini::parser;
+using config::ini::resource_parser;
+
+namespace {
+/**
+ * Returns true if the value of \p e is stored in [\p first, \p last).
+ */
+bool stored_in(const resource_parser::event &e, const char *first,
+               const char *last) {
+    return e.value.data() >= first && e.value.data() < last;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_resource_parser_matches_parser) {
+    const char input[] =
+        "[a section name longer than the small string buffer]\n"
+        "key = 'a quoted value that is long enough to allocate'\n"
+        "long = first part of a folded \\\n    value\n"
+        "bad\n";
+    char buffer[4096];
+    monotonic_buffer_resource arena(buffer, sizeof(buffer));
+    std::istringstream in1(input), in2(input);
+    parser p("test.ini", in1);
+    resource_parser r("test.ini", in2, &arena);
+    BOOST_CHECK(r.get_resource() == &arena);
+    parser::event e;
+    resource_parser::event re(&arena);
+    for (;;) {
+        const bool ok = p.advance(e);
+        BOOST_CHECK(r.advance(re) == ok);
+        BOOST_CHECK(re.type == e.type);
+        BOOST_CHECK(std::string(re.value.data(), re.value.size()) ==
+                    e.value);
+        BOOST_CHECK(re.offset == e.offset);
+        BOOST_CHECK(re.length == e.length);
+        if (re.value.size() > 32)
+            BOOST_CHECK(stored_in(re, buffer, buffer + sizeof(buffer)));
+        if (!ok)
+            break;
+    }
+    BOOST_CHECK(re.type == parser::EVENT_ERROR);
+}
+
+BOOST_AUTO_TEST_CASE(test_resource_parser_value_parts) {
+    const char input[] = "x = 'a value that is split into parts of four'\n";
+    char buffer[4096];
+    monotonic_buffer_resource arena(buffer, sizeof(buffer));
+    std::istringstream in(input);
+    resource_parser r("test.ini", in, &arena);
+    r.set_value_chunk_size(4);
+    resource_parser::event e(&arena);
+    BOOST_REQUIRE(r.advance(e) && e.type == parser::EVENT_NAME);
+    std::string value;
+    while (r.advance(e) && e.type == parser::EVENT_VALUE_PART)
+        value.append(e.value.data(), e.value.size());
+    BOOST_CHECK(e.type == parser::EVENT_VALUE);
+    value.append(e.value.data(), e.value.size());
+    BOOST_CHECK(value == "a value that is split into parts of four");
+    BOOST_CHECK(!r.advance(e));
+    BOOST_CHECK(e.type == parser::EVENT_END);
+}
@@ -0,0 +1,218 @@
+#include "config/ini/client.hpp"
+#include "config/ini/server.hpp"
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <sstream>
+
+#include <cstring>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using config::ini::client;
+using config::ini::server;
+
+namespace {
+struct fixture {
+    fixture() {
+        char tmpl[] = "/tmp/config-ini-test.XXXXXX";
+        dir = mkdtemp(tmpl);
+        config = dir + "/app.ini";
+        socket = dir + "/app.sock";
+        write("[db]\nhost = localhost\nport = 5432\n[app]\nname = x\n");
+    }
+
+    ~fixture() {
+        unlink(config.c_str());
+        unlink(socket.c_str());
+        rmdir(dir.c_str());
+    }
+
+    void write(const std::string &content) {
+        const std::string tmp = config + ".tmp";
+        std::ofstream out(tmp.c_str());
+        out << content;
+        out.close();
+        rename(tmp.c_str(), config.c_str());
+    }
+
+    std::string dir;
+    std::string config;
+    std::string socket;
+};
+
+void *serve(void *arg) {
+    static_cast<server *>(arg)->run();
+    return 0;
+}
+
+template <typename T> void put(std::string &out, T v) {
+    out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+void put_str(std::string &out, const std::string &s) {
+    put(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+/**
+ * Sends pipelined requests without reading, then shuts down its side.
+ */
+struct writer {
+    int fd;
+    std::string requests;
+
+    static void *run(void *arg) {
+        writer *w = static_cast<writer *>(arg);
+        std::size_t pos = 0;
+        while (pos < w->requests.size()) {
+            const ssize_t n = ::write(w->fd, w->requests.data() + pos,
+                                      w->requests.size() - pos);
+            if (n <= 0)
+                break;
+            pos += n;
+        }
+        ::shutdown(w->fd, SHUT_WR);
+        return 0;
+    }
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_server_batched_lookups) {
+    fixture f;
+    server srv(f.config);
+    BOOST_REQUIRE_MESSAGE(srv.listen(f.socket), srv.error());
+    pthread_t thread;
+    pthread_create(&thread, 0, &serve, &srv);
+
+    client c(f.socket);
+    c.set_batch_size(2);
+    std::vector<client::query> queries;
+    queries.push_back(client::query("db", "host"));
+    queries.push_back(client::query("db", "port"));
+    queries.push_back(client::query("db", "user"));
+    queries.push_back(client::query("app", "name"));
+    queries.push_back(client::query("app", "name"));
+    BOOST_REQUIRE_MESSAGE(c.lookup(queries), c.error());
+    BOOST_CHECK(queries[0].found && queries[0].value == "localhost");
+    BOOST_CHECK(queries[1].found && queries[1].value == "5432");
+    BOOST_CHECK(!queries[2].found);
+    BOOST_CHECK(queries[4].found && queries[4].value == "x");
+    BOOST_CHECK(c.generation() == 1);
+
+    std::vector<std::string> names;
+    BOOST_REQUIRE(c.list("db", names));
+    BOOST_CHECK(names.size() == 2 && names[0] == "host" &&
+                names[1] == "port");
+    BOOST_REQUIRE(c.list("missing", names));
+    BOOST_CHECK(names.empty());
+
+    srv.stop();
+    pthread_join(thread, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_server_large_lookup) {
+    fixture f;
+    const std::string value(200, 'v');
+    f.write("[big]\nvalue = " + value + "\n");
+    server srv(f.config);
+    BOOST_REQUIRE_MESSAGE(srv.listen(f.socket), srv.error());
+    pthread_t thread;
+    pthread_create(&thread, 0, &serve, &srv);
+
+    // About 4 MiB of responses, more than the server buffers per
+    // connection, so requests and responses have to interleave.
+    client c(f.socket);
+    c.set_batch_size(50);
+    std::vector<client::query> queries(20000, client::query("big", "value"));
+    BOOST_REQUIRE_MESSAGE(c.lookup(queries), c.error());
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < queries.size(); ++i)
+        found += queries[i].found && queries[i].value == value;
+    BOOST_CHECK(found == queries.size());
+
+    srv.stop();
+    pthread_join(thread, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_server_reloads_changed_files) {
+    fixture f;
+    server srv(f.config);
+    BOOST_REQUIRE(srv.listen(f.socket));
+    f.write("[db]\nhost = remote\n");
+    BOOST_REQUIRE(srv.run_once(1000));
+    BOOST_CHECK(srv.generation() == 2);
+    BOOST_CHECK(*srv.get_document().get("db", "host") == "remote");
+
+    // A broken file keeps the previous document.
+    f.write("[db\n");
+    BOOST_REQUIRE(srv.run_once(1000));
+    BOOST_CHECK(srv.generation() == 2);
+    BOOST_CHECK(*srv.get_document().get("db", "host") == "remote");
+}
+
+BOOST_AUTO_TEST_CASE(test_server_answers_after_half_close) {
+    fixture f;
+    server srv(f.config);
+    BOOST_REQUIRE_MESSAGE(srv.listen(f.socket), srv.error());
+    pthread_t thread;
+    pthread_create(&thread, 0, &serve, &srv);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, f.socket.c_str());
+    BOOST_REQUIRE(::connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                            sizeof(addr)) == 0);
+
+    // The responses outgrow the output the server buffers per
+    // connection, so it has to stop reading and resume.
+    const uint32_t count = 100000;
+    writer w;
+    w.fd = fd;
+    for (uint32_t id = 0; id < count; ++id) {
+        std::string body;
+        put(body, id);
+        put(body, uint8_t(1));
+        put(body, uint32_t(1));
+        put_str(body, "db");
+        put_str(body, "host");
+        put(w.requests, static_cast<uint32_t>(body.size()));
+        w.requests.append(body);
+    }
+    pthread_t writer_thread;
+    pthread_create(&writer_thread, 0, &writer::run, &w);
+
+    // Let the output pile up and the writer shut down before reading.
+    usleep(200000);
+    std::string in;
+    char buf[65536];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+        in.append(buf, n);
+    pthread_join(writer_thread, 0);
+    ::close(fd);
+
+    uint32_t answered = 0;
+    bool ordered = true;
+    for (std::size_t pos = 0; pos + 8 <= in.size();) {
+        uint32_t size, id;
+        std::memcpy(&size, in.data() + pos, sizeof(size));
+        std::memcpy(&id, in.data() + pos + 4, sizeof(id));
+        if (in.size() - pos - sizeof(size) < size)
+            break;
+        ordered = ordered && id == answered;
+        ++answered;
+        pos += sizeof(size) + size;
+    }
+    BOOST_CHECK(answered == count);
+    BOOST_CHECK(ordered);
+
+    srv.stop();
+    pthread_join(thread, 0);
+}
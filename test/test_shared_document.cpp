@@ -0,0 +1,96 @@
+#include "config/ini/document.hpp"
+#include "config/ini/shared_document.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using config::ini::document;
+using config::ini::shared_document;
+using config::ini::shared_publisher;
+
+namespace {
+std::string shm_name() {
+    std::ostringstream ss;
+    ss << "/config-ini-test." << getpid();
+    return ss.str();
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_document_lookups) {
+    document::options opts;
+    opts.case_insensitive = true;
+    opts.duplicate_params = document::DUPLICATE_MERGE;
+    document doc(opts);
+    doc.add_param("top", "0");
+    doc.add_section("DB");
+    doc.add_param("host", "localhost");
+    doc.add_param("replica", "a");
+    doc.add_param("replica", "b");
+
+    shared_publisher pub(shm_name());
+    BOOST_REQUIRE_MESSAGE(pub.publish(doc), pub.error());
+    shared_document shared(shm_name());
+    BOOST_REQUIRE_MESSAGE(shared.refresh(), shared.error());
+    BOOST_CHECK(shared.generation() == pub.generation());
+
+    std::string value;
+    BOOST_CHECK(shared.get("", "top", value) && value == "0");
+    BOOST_CHECK(shared.get("db", "HOST", value) && value == "localhost");
+    BOOST_CHECK(!shared.get("db", "port", value));
+    std::vector<std::string> all;
+    BOOST_CHECK(shared.get_all("db", "replica", all) == 2);
+    BOOST_CHECK(all.size() == 2 && all[0] == "a" && all[1] == "b");
+    pub.remove();
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_document_generations) {
+    shared_publisher pub(shm_name());
+    shared_document shared(shm_name());
+    BOOST_CHECK(!shared.refresh());
+
+    document first;
+    first.add_section("a");
+    first.add_param("x", "1");
+    BOOST_REQUIRE(pub.publish(first));
+    BOOST_REQUIRE(shared.refresh());
+    const uint64_t generation = shared.generation();
+
+    document second;
+    second.add_section("a");
+    second.add_param("x", "2");
+    BOOST_REQUIRE(pub.publish(second));
+    std::string value;
+    BOOST_CHECK(shared.get("a", "x", value) && value == "1");
+    BOOST_REQUIRE(shared.refresh());
+    BOOST_CHECK(shared.generation() == generation + 1);
+    BOOST_CHECK(shared.get("a", "x", value) && value == "2");
+    pub.remove();
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_document_publisher_busy) {
+    shared_publisher pub(shm_name());
+    document doc;
+    doc.add_param("x", "1");
+    BOOST_REQUIRE_MESSAGE(pub.publish(doc), pub.error());
+
+    // Freeze the sequence lock in the middle of an update.
+    const int fd = shm_open(shm_name().c_str(), O_RDWR, 0);
+    BOOST_REQUIRE(fd >= 0);
+    void *p = mmap(0, 8, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    BOOST_REQUIRE(p != MAP_FAILED);
+    uint32_t *seq = static_cast<uint32_t *>(p) + 1;
+    ++*seq;
+
+    shared_document shared(shm_name());
+    BOOST_CHECK(!shared.refresh());
+    BOOST_CHECK(shared.error().find("publisher busy") != std::string::npos);
+
+    --*seq;
+    BOOST_CHECK_MESSAGE(shared.refresh(), shared.error());
+    munmap(p, 8);
+    pub.remove();
+}
@@ -0,0 +1,60 @@
+/*
+   Copyright 2013 Roman Kashitsyn
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @detail Serves a configuration file over a Unix domain socket until
+ * SIGINT or SIGTERM.
+ */
+
+#include "config/ini/server.hpp"
+#include <iostream>
+
+#include <signal.h>
+
+namespace {
+config::ini::server *instance = 0;
+
+void on_signal(int) {
+    if (instance)
+        instance->stop();
+}
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " CONFIG SOCKET" << std::endl;
+        return 2;
+    }
+    config::ini::server srv(argv[1]);
+    if (!srv.listen(argv[2])) {
+        std::cerr << srv.error() << std::endl;
+        return 1;
+    }
+    instance = &srv;
+    struct sigaction sa;
+    sa.sa_handler = &on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+    if (!srv.run()) {
+        std::cerr << srv.error() << std::endl;
+        return 1;
+    }
+    return 0;
+}